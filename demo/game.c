@@ -7,9 +7,10 @@
 
 #include "asset.h"
 #include "asset_cache.h"
+#include "bvh.h"
 #include "collision.h"
-#include "forces.h"
 #include "sdl_wrapper.h"
+#include "task_graph.h"
 
 // window constants
 const vector_t MIN = {0, 0};
@@ -87,7 +88,7 @@ const size_t BRICK_WIDTH = 20;
 const size_t BRICK_NUM[3] = {14, 12, 12};
 
 // Bricks for Map 1
-size_t BRICKS1[14][4] = {
+const size_t BRICKS1[14][4] = {
     {375, -500, 750, 30}, {160, 425, 320, 20}, {560, 425, 150, 20},
     {425, 300, 650, 20},  {325, 200, 650, 20}, {180, 75, 175, 20},
     {500, 75, 175, 20},   {730, 330, 40, 60},  {30, 235, 60, 70},
@@ -147,6 +148,10 @@ const size_t ELEVATORS[3][4] = {
 
 // elevator ranges
 const size_t ELEVATOR_RANGES[3][2] = {{310, 230}, {310, 35}, {310, 210}};
+// how far an elevator must pass the end of its range to turn around. Elevators
+// move a third of a pixel a tick, so they land right on the ends, where floats
+// (see SIM_FLOAT32) can land a hair either side of where doubles do.
+const double ELEVATOR_SLACK = 0.1;
 
 // elevator buttons
 const size_t E_BUTTONS[2][4] = {{475, 150, 30, 20}, {400, 25, 30, 20}};
@@ -178,8 +183,62 @@ const vector_t ELEVATOR_DOWN = (vector_t){0, -20};
 // gravity constants
 const double GRAVITY = 320;
 
+// the level is simulated in ticks of a fixed length, however often frames are
+// drawn, and frames are drawn between the last two ticks; see set_tick_rate()
+const double DEFAULT_TICK_RATE = 60; // ticks per second
+// after a slow frame, at most this many ticks are run to catch up
+const size_t MAX_TICKS_PER_FRAME = 5;
+const size_t INIT_RENDER_ITEMS = 32;
+
+// collision categories
+typedef enum {
+  SPIRIT_CATEGORY = 1 << 0,
+  PLATFORM_CATEGORY = 1 << 1,
+  LAVA_CATEGORY = 1 << 2,
+  GEM_CATEGORY = 1 << 3,
+  EXIT_CATEGORY = 1 << 4,
+  BUTTON_CATEGORY = 1 << 5
+} category_t;
+
+// what the systems that make up a frame read and write; see init_frame()
+typedef enum {
+  // the scene's bodies, and where they are drawn between ticks
+  SCENE_RESOURCE = 1 << 0,
+  // the game's progress, e.g. the time and whether the level is running
+  STATE_RESOURCE = 1 << 1,
+  ASSETS_RESOURCE = 1 << 2,
+  AUDIO_RESOURCE = 1 << 3,
+  RENDER_LIST_RESOURCE = 1 << 4,
+  CLOCK_RESOURCE = 1 << 5,
+  SCREEN_RESOURCE = 1 << 6
+} resource_t;
+
+// an asset to draw this frame, and where
+typedef struct render_item {
+  asset_t *asset;
+  SDL_Rect box;
+} render_item_t;
+
+// a growable array of assets to draw; see ARRAY_DEFINE()
+ARRAY_DEFINE(render_list, render_item_t)
+
+// how close a platform must be to the spirit to count as touching it
+const double CONTACT_DISTANCE = 1;
+const size_t NUM_CONTACT_PROBES = 4;
+const vector_t CONTACT_PROBES[4] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0}};
+
 bool game_over = false;
 
+// every obstacle is this square stretched, and every spirit and gem this
+// circle; see init_shapes()
+shape_template_t *square_shape = NULL;
+shape_template_t *circle_shape = NULL;
+
+// what each body is, which handlers and level logic compare against;
+// see init_kinds()
+body_kind_t platform_kind, lava_kind, water_kind, exit_kind, gem_kind;
+body_kind_t door_kind, door_button_kind, elevator_kind, elevator_button_kind;
+
 typedef enum {
   LEVEL1 = 1,
   LEVEL2 = 2,
@@ -196,58 +255,86 @@ struct state {
   double level_points[3];
   bool level_completed[3];
   double time;
+  // the time since the last tick that has not been simulated yet
+  double tick_time;
+  // how many ticks the level is simulated in per second
+  double tick_rate;
   TTF_Font *font;
+  // the door the level's door button opens, if it has one
+  body_handle_t door;
+  size_t gems_collected;
+  // the systems run each frame, and what they pass to each other
+  task_graph_t *frame;
+  bool running;
+  render_list_t render_list;
+  char clock_text[32];
+  SDL_Rect clock_rect;
 };
 
-body_t *make_obstacle(size_t w, size_t h, vector_t center, char *info) {
-  list_t *c = list_init(4, free);
-  vector_t *v1 = malloc(sizeof(vector_t));
+// the unit shapes that bodies are stretched from
+void init_shapes() {
+  vector_t corners[] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+  // shape_template_init() copies the corners, so they can stay on the stack
+  vector_array_t c = {.data = corners, .size = 4, .capacity = 4};
+  square_shape = shape_template_init(&c);
 
-  *v1 = (vector_t){0, 0};
-  list_add(c, v1);
-
-  vector_t *v2 = malloc(sizeof(vector_t));
-  *v2 = (vector_t){w, 0};
-  list_add(c, v2);
-
-  vector_t *v3 = malloc(sizeof(vector_t));
-  *v3 = (vector_t){w, h};
-  list_add(c, v3);
+  vector_array_t points = vector_array_init(SPIRIT_NUM_POINTS);
+  for (size_t i = 0; i < SPIRIT_NUM_POINTS; i++) {
+    double angle = 2 * M_PI * i / SPIRIT_NUM_POINTS;
+    vector_array_add(&points, (vector_t){cos(angle), sin(angle)});
+  }
+  circle_shape = shape_template_init(&points);
+  vector_array_free(&points);
+}
 
-  vector_t *v4 = malloc(sizeof(vector_t));
-  *v4 = (vector_t){0, h};
-  list_add(c, v4);
+// the kinds of bodies that the game tells apart
+void init_kinds() {
+  platform_kind = body_kind_intern("platform");
+  lava_kind = body_kind_intern("lava");
+  water_kind = body_kind_intern("water");
+  exit_kind = body_kind_intern("exit");
+  gem_kind = body_kind_intern("gem");
+  door_kind = body_kind_intern("door");
+  door_button_kind = body_kind_intern("door button");
+  elevator_kind = body_kind_intern("elevator");
+  elevator_button_kind = body_kind_intern("elevator button");
+}
 
-  body_t *obstacle = body_init_with_info(c, __DBL_MAX__, OBS_COLOR, info, NULL);
+body_t *make_obstacle(size_t w, size_t h, vector_t center, body_kind_t kind) {
+  body_t *obstacle = body_init_with_template(
+      square_shape, (vector_t){w, h}, __DBL_MAX__, OBS_COLOR, NULL, NULL);
+  body_set_kind(obstacle, kind);
   body_set_centroid(obstacle, center);
+  // most obstacles never move; elevators are made kinematic instead
+  body_set_type(obstacle, BODY_STATIC);
   return obstacle;
 }
 
+// lava, water, exits and buttons only need to know when the spirit is inside
+body_t *make_sensor(size_t w, size_t h, vector_t center, body_kind_t kind) {
+  body_t *sensor = make_obstacle(w, h, center, kind);
+  body_set_sensor(sensor, true);
+  return sensor;
+}
+
 body_t *make_spirit(double outer_radius, double inner_radius, vector_t center) {
   center.y += inner_radius;
-  list_t *c = list_init(SPIRIT_NUM_POINTS, free);
-  for (size_t i = 0; i < SPIRIT_NUM_POINTS; i++) {
-    double angle = 2 * M_PI * i / SPIRIT_NUM_POINTS;
-    vector_t *v = malloc(sizeof(*v));
-    *v = (vector_t){center.x + inner_radius * cos(angle),
-                    center.y + outer_radius * sin(angle)};
-    list_add(c, v);
-  }
-  body_t *spirit = body_init(c, 1, SPIRIT_COLOR);
+  vector_t radii = {inner_radius, outer_radius};
+  body_t *spirit = body_init_with_template(circle_shape, radii, 1, SPIRIT_COLOR,
+                                           NULL, NULL);
+  body_set_centroid(spirit, center);
   return spirit;
 }
 
 body_t *make_gem(double outer_radius, double inner_radius, vector_t center) {
   center.y += inner_radius;
-  list_t *c = list_init(SPIRIT_NUM_POINTS, free);
-  for (size_t i = 0; i < SPIRIT_NUM_POINTS; i++) {
-    double angle = 2 * M_PI * i / SPIRIT_NUM_POINTS;
-    vector_t *v = malloc(sizeof(*v));
-    *v = (vector_t){center.x + inner_radius * cos(angle),
-                    center.y + outer_radius * sin(angle)};
-    list_add(c, v);
-  }
-  body_t *gem = body_init_with_info(c, 1, OBS_COLOR, "gem", NULL);
+  vector_t radii = {inner_radius, outer_radius};
+  body_t *gem =
+      body_init_with_template(circle_shape, radii, 1, OBS_COLOR, NULL, NULL);
+  body_set_kind(gem, gem_kind);
+  body_set_centroid(gem, center);
+  body_set_type(gem, BODY_STATIC);
+  body_set_sensor(gem, true);
   return gem;
 }
 
@@ -256,64 +343,78 @@ body_t *make_gem(double outer_radius, double inner_radius, vector_t center) {
 // reset the posiiton of the user
 void reset_user(body_t *body) {
   body_set_centroid(body, (vector_t){-500, -500});
+  // jump there, rather than sliding there over the frame
+  body_save_pose(body);
 }
 
-// when the player dies
-void lose_handler(body_t *body1, body_t *body2, vector_t axis, void *aux,
-                  double force_const) {
-  reset_user(body1);
+// when the player touches lava
+void lose_handler(body_t *lava, body_t *spirit, sensor_event_t event,
+                  void *aux) {
+  reset_user(spirit);
   asset_make_image(GAME_OVER_PATH, POP_UP_BOX);
   sdl_play_level_failed(FAILED_SOUND_PATH);
   game_over = true;
 }
 
-// when the player completes a level
-void win_handler(body_t *body1, body_t *body2, vector_t axis, void *aux,
-                 double force_const) {
-  reset_user(body1);
+// when the player reaches the exit
+void win_handler(body_t *exit, body_t *spirit, sensor_event_t event,
+                 void *aux) {
+  state_t *state = aux;
+  state->level_completed[state->current_screen - 1] = true;
+  reset_user(spirit);
   asset_make_image(WIN_PATH, POP_UP_BOX);
   sdl_play_level_completed(COMPLETED_SOUND_PATH);
   game_over = true;
 }
 
-// when the user collides with a gem
-void gem_user_handler(body_t *body1, body_t *body2, vector_t axis, void *aux,
-                      double force_const) {
-  asset_remove_body(body2);
-  body_remove(body2);
+// when the user touches a gem
+void gem_user_handler(body_t *gem, body_t *spirit, sensor_event_t event,
+                      void *aux) {
+  state_t *state = aux;
+  state->gems_collected++;
+  body_remove(gem);
   sdl_play_gem_sound(GEM_SOUND_PATH);
 }
 
+void button_action(state_t *state, body_t *button) {
+  body_kind_t kind = body_get_kind(button);
+  if (kind == door_button_kind) {
+    // the door is gone if the button was already pressed
+    body_t *door = body_from_handle(state->door);
+    if (door != NULL) {
+      body_remove(door);
+    }
+  } else if (kind == elevator_button_kind) {
+    state->elevator = true;
+  }
+}
+
+// when the user steps on a door or elevator button
+void button_handler(body_t *button, body_t *spirit, sensor_event_t event,
+                    void *aux) {
+  asset_t *asset = asset_find_by_body(button, ASSET_BUTTON);
+  if (asset != NULL) {
+    asset_change_texture_button(asset);
+  }
+  button_action(aux, button);
+}
+
 // when the user collides with a platform
 void platform_handler(body_t *body1, body_t *body2, vector_t axis, void *aux,
                       double force_const) {
 
   vector_t vel = body_get_velocity(body1);
-  vector_t cen = body_get_centroid(body1);
-  list_t *pts = body_get_shape(body2);
-  vector_t *v1 = list_get(pts, 0);
-  vector_t *v2 = list_get(pts, 1);
-  vector_t *v3 = list_get(pts, 2);
-  vector_t *v4 = list_get(pts, 3);
-
-  if (cen.x > v4->x - INNER_RADIUS && cen.x < v3->x + INNER_RADIUS &&
-      cen.y - (INNER_RADIUS - 8) >= v4->y) {
-    vel.y = 0;
-  }
 
-  if (cen.x > v1->x - INNER_RADIUS && cen.x < v2->x + INNER_RADIUS &&
-      cen.y < v1->y) {
+  switch (collision_face(axis)) {
+  case UP_COLLISION:
+    vel.y = 0;
+    break;
+  case DOWN_COLLISION:
     vel.y = -vel.y;
-  }
-
-  if (cen.y > v1->y - OUTER_RADIUS && cen.y < v4->y + OUTER_RADIUS &&
-      cen.x < v1->x) {
-    vel.x = 0;
-  }
-
-  if (cen.y > v2->y - OUTER_RADIUS && cen.y < v3->y + OUTER_RADIUS &&
-      cen.x > v2->x) {
+    break;
+  default:
     vel.x = 0;
+    break;
   }
 
   body_set_velocity(body1, vel);
@@ -323,15 +424,35 @@ vector_t get_dimensions_for_text(char *text) {
   return (vector_t){strlen(text) * TEXT_SIZE, TEXT_SIZE * TEXT_HEIGHT_SCALE};
 }
 
+// what happens when the spirit touches each kind of body
+void add_handlers(state_t *state) {
+  scene_t *scene = state->scene;
+  scene_add_collision_handler(scene, SPIRIT_CATEGORY, PLATFORM_CATEGORY,
+                              platform_handler, NULL, 0, NULL);
+  uint32_t enter = SENSOR_EVENT_BIT(SENSOR_ENTER);
+  scene_add_sensor_handler(scene, LAVA_CATEGORY, SPIRIT_CATEGORY, lose_handler,
+                           enter, NULL, NULL);
+  scene_add_sensor_handler(scene, GEM_CATEGORY, SPIRIT_CATEGORY,
+                           gem_user_handler, enter, state, NULL);
+  scene_add_sensor_handler(scene, EXIT_CATEGORY, SPIRIT_CATEGORY, win_handler,
+                           enter, state, NULL);
+  scene_add_sensor_handler(scene, BUTTON_CATEGORY, SPIRIT_CATEGORY,
+                           button_handler, enter, state, NULL);
+}
+
 void init_bgd_player(state_t *state) {
   state->time = 0;
   asset_make_image(BACKGROUND_PATH, BACKGROUND_BOX);
 
   body_t *spirit = make_spirit(OUTER_RADIUS, INNER_RADIUS, VEC_ZERO);
   body_set_centroid(spirit, START_POS);
+  // sweep the spirit so it cannot fall through thin platforms on slow frames
+  body_set_fast(spirit, true);
   // state->spirit = spirit;
   state->collision_type = NO_COLLISION;
+  body_set_category(spirit, SPIRIT_CATEGORY);
   scene_add_body(state->scene, spirit);
+  add_handlers(state);
 
   // spirit
   asset_make_spirit(SPIRIT_FRONT_PATH, SPIRIT_LEFT_PATH, SPIRIT_RIGHT_PATH,
@@ -340,6 +461,36 @@ void init_bgd_player(state_t *state) {
 
 // LEVEL INITIALIZATIONS
 
+// make the brick platforms: every brick gets its own sprite, but abutting
+// bricks share one collision body
+void make_platforms(state_t *state, const size_t bricks[][4], size_t count) {
+  aabb_t *boxes = malloc(sizeof(aabb_t) * count);
+  assert(boxes != NULL);
+  size_t num_boxes = 0;
+  for (size_t i = 0; i < count; i++) {
+    vector_t center = (vector_t){bricks[i][0], bricks[i][1]};
+    // a brick parked off the map (level 1 has one at y = -500, which wraps
+    // around as a size_t) is too far away for its box to have any size
+    if (center.x > MAX.x || center.y > MAX.y) {
+      continue;
+    }
+    vector_t half = (vector_t){bricks[i][2] / 2.0, bricks[i][3] / 2.0};
+    aabb_t box = {vec_subtract(center, half), vec_add(center, half)};
+    boxes[num_boxes++] = box;
+    asset_make_image(BRICK_PATH, sdl_get_bounding_box(box.min, box.max));
+  }
+
+  num_boxes = aabb_merge(boxes, num_boxes);
+  for (size_t i = 0; i < num_boxes; i++) {
+    vector_t size = vec_subtract(boxes[i].max, boxes[i].min);
+    vector_t center = vec_multiply(0.5, vec_add(boxes[i].min, boxes[i].max));
+    body_t *platform = make_obstacle(size.x, size.y, center, platform_kind);
+    scene_add_body(state->scene, platform);
+    body_set_category(platform, PLATFORM_CATEGORY);
+  }
+  free(boxes);
+}
+
 typedef void (*make_level_t)(state_t *);
 
 void make_level1(state_t *state) {
@@ -348,25 +499,15 @@ void make_level1(state_t *state) {
   init_bgd_player(state);
 
   // make brick platforms
-  size_t brick_len = BRICK_NUM[0];
-  for (size_t i = 0; i < brick_len; i++) {
-    vector_t coord = (vector_t){BRICKS1[i][0], BRICKS1[i][1]};
-    body_t *obstacle =
-        make_obstacle(BRICKS1[i][2], BRICKS1[i][3], coord, "platform");
-    scene_add_body(state->scene, obstacle);
-    create_collision(state->scene, scene_get_body(state->scene, 0), obstacle,
-                     platform_handler, NULL, 0, NULL);
-    asset_make_image_with_body(BRICK_PATH, obstacle);
-  }
+  make_platforms(state, BRICKS1, BRICK_NUM[0]);
 
   // make lava
   size_t lava_len = LAVA_NUM[0];
   for (size_t i = 0; i < lava_len; i++) {
     vector_t coord = (vector_t){LAVA1[i][0], LAVA1[i][1]};
-    body_t *obstacle = make_obstacle(LAVA1[i][2], LAVA1[i][3], coord, "lava");
+    body_t *obstacle = make_sensor(LAVA1[i][2], LAVA1[i][3], coord, lava_kind);
     scene_add_body(state->scene, obstacle);
-    create_collision(state->scene, scene_get_body(state->scene, 0), obstacle,
-                     lose_handler, NULL, 0, NULL);
+    body_set_category(obstacle, LAVA_CATEGORY);
     asset_make_anim(LAVA1_PATH, LAVA2_PATH, LAVA3_PATH, obstacle);
   }
 
@@ -375,7 +516,7 @@ void make_level1(state_t *state) {
   for (size_t i = 0; i < water_len; i++) {
     vector_t coord = (vector_t){WATER1[i][0], WATER1[i][1]};
     body_t *obstacle =
-        make_obstacle(WATER1[i][2], WATER1[i][3], coord, "water");
+        make_sensor(WATER1[i][2], WATER1[i][3], coord, water_kind);
     scene_add_body(state->scene, obstacle);
     asset_make_anim(WATER1_PATH, WATER2_PATH, WATER3_PATH, obstacle);
   }
@@ -386,17 +527,15 @@ void make_level1(state_t *state) {
     vector_t center = (vector_t){GEM1[i][0], GEM1[i][1]};
     body_t *gem = make_gem(OUTER_RADIUS, INNER_RADIUS, center);
     scene_add_body(state->scene, gem);
-    create_collision(state->scene, scene_get_body(state->scene, 0), gem,
-                     gem_user_handler, NULL, 0, NULL);
+    body_set_category(gem, GEM_CATEGORY);
     asset_make_image_with_body(GEM_PATH, gem);
   }
 
   // make exit
   vector_t coord = (vector_t){EXITS[0][0], EXITS[0][1]};
-  body_t *exit = make_obstacle(EXITS[0][2], EXITS[0][3], coord, "exit");
+  body_t *exit = make_sensor(EXITS[0][2], EXITS[0][3], coord, exit_kind);
   scene_add_body(state->scene, exit);
-  create_collision(state->scene, scene_get_body(state->scene, 0), exit,
-                   win_handler, NULL, 0, NULL);
+  body_set_category(exit, EXIT_CATEGORY);
   asset_make_image_with_body(EXIT_DOOR_PATH, exit);
 }
 
@@ -406,25 +545,15 @@ void make_level2(state_t *state) {
   init_bgd_player(state);
 
   // make brick platforms
-  size_t brick_len = BRICK_NUM[1];
-  for (size_t i = 0; i < brick_len; i++) {
-    vector_t coord = (vector_t){BRICKS2[i][0], BRICKS2[i][1]};
-    body_t *obstacle =
-        make_obstacle(BRICKS2[i][2], BRICKS2[i][3], coord, "platform");
-    scene_add_body(state->scene, obstacle);
-    create_collision(state->scene, scene_get_body(state->scene, 0), obstacle,
-                     platform_handler, NULL, 0, NULL);
-    asset_make_image_with_body(BRICK_PATH, obstacle);
-  }
+  make_platforms(state, BRICKS2, BRICK_NUM[1]);
 
   // make lava
   size_t lava_len = LAVA_NUM[1];
   for (size_t i = 0; i < lava_len; i++) {
     vector_t coord = (vector_t){LAVA2[i][0], LAVA2[i][1]};
-    body_t *obstacle = make_obstacle(LAVA2[i][2], LAVA2[i][3], coord, "lava");
+    body_t *obstacle = make_sensor(LAVA2[i][2], LAVA2[i][3], coord, lava_kind);
     scene_add_body(state->scene, obstacle);
-    create_collision(state->scene, scene_get_body(state->scene, 0), obstacle,
-                     lose_handler, NULL, 0, NULL);
+    body_set_category(obstacle, LAVA_CATEGORY);
     asset_make_anim(LAVA1_PATH, LAVA2_PATH, LAVA3_PATH, obstacle);
   }
 
@@ -433,7 +562,7 @@ void make_level2(state_t *state) {
   for (size_t i = 0; i < water_len; i++) {
     vector_t coord = (vector_t){WATER2[i][0], WATER2[i][1]};
     body_t *obstacle =
-        make_obstacle(WATER2[i][2], WATER2[i][3], coord, "water");
+        make_sensor(WATER2[i][2], WATER2[i][3], coord, water_kind);
     scene_add_body(state->scene, obstacle);
     asset_make_anim(WATER1_PATH, WATER2_PATH, WATER3_PATH, obstacle);
   }
@@ -444,53 +573,49 @@ void make_level2(state_t *state) {
     vector_t center = (vector_t){GEM2[i][0], GEM2[i][1]};
     body_t *gem = make_gem(OUTER_RADIUS, INNER_RADIUS, center);
     scene_add_body(state->scene, gem);
-    create_collision(state->scene, scene_get_body(state->scene, 0), gem,
-                     gem_user_handler, NULL, 0, NULL);
+    body_set_category(gem, GEM_CATEGORY);
     asset_make_image_with_body(GEM_PATH, gem);
   }
 
   // make exit
   vector_t coord = (vector_t){EXITS[1][0], EXITS[1][1]};
-  body_t *exit = make_obstacle(EXITS[1][2], EXITS[1][3], coord, "exit");
+  body_t *exit = make_sensor(EXITS[1][2], EXITS[1][3], coord, exit_kind);
   scene_add_body(state->scene, exit);
-  create_collision(state->scene, scene_get_body(state->scene, 0), exit,
-                   win_handler, NULL, 0, NULL);
+  body_set_category(exit, EXIT_CATEGORY);
   asset_make_image_with_body(EXIT_DOOR_PATH, exit);
 
   // make elevator
   vector_t e_coord = (vector_t){ELEVATORS[0][0], ELEVATORS[0][1]};
   body_t *elevator =
-      make_obstacle(ELEVATORS[0][2], ELEVATORS[0][3], e_coord, "elevator");
+      make_obstacle(ELEVATORS[0][2], ELEVATORS[0][3], e_coord, elevator_kind);
+  body_set_type(elevator, BODY_KINEMATIC);
   scene_add_body(state->scene, elevator);
-  create_collision(state->scene, scene_get_body(state->scene, 0), elevator,
-                   platform_handler, NULL, 0, NULL);
+  body_set_category(elevator, PLATFORM_CATEGORY);
   asset_make_image_with_body(ELEVATOR_PATH, elevator);
 
   // make elevator button
   vector_t e_button_coord = (vector_t){E_BUTTONS[0][0], E_BUTTONS[0][1]};
-  body_t *e_button = make_obstacle(E_BUTTONS[0][2], E_BUTTONS[0][3],
-                                   e_button_coord, "elevator button");
+  body_t *e_button = make_sensor(E_BUTTONS[0][2], E_BUTTONS[0][3],
+                                 e_button_coord, elevator_button_kind);
   scene_add_body(state->scene, e_button);
-  create_collision(state->scene, scene_get_body(state->scene, 0), e_button,
-                   platform_handler, NULL, 0, NULL);
+  body_set_category(e_button, BUTTON_CATEGORY);
   asset_make_button(ELEVATOR_BUTTON_UNPRESSED_PATH,
                     ELEVATOR_BUTTON_PRESSED_PATH, e_button);
 
   // make door
   vector_t door_coord = (vector_t){DOORS[0][0], DOORS[0][1]};
-  body_t *door = make_obstacle(DOORS[0][2], DOORS[0][3], door_coord, "door");
+  body_t *door = make_obstacle(DOORS[0][2], DOORS[0][3], door_coord, door_kind);
   scene_add_body(state->scene, door);
-  create_collision(state->scene, scene_get_body(state->scene, 0), door,
-                   platform_handler, NULL, 0, NULL);
+  state->door = body_get_handle(door);
+  body_set_category(door, PLATFORM_CATEGORY);
   asset_make_image_with_body(DOOR_PATH, door);
 
   // make door button
   vector_t button_coord = (vector_t){BUTTONS[0][0], BUTTONS[0][1]};
   body_t *button =
-      make_obstacle(BUTTONS[0][2], BUTTONS[0][3], button_coord, "door button");
+      make_sensor(BUTTONS[0][2], BUTTONS[0][3], button_coord, door_button_kind);
   scene_add_body(state->scene, button);
-  create_collision(state->scene, scene_get_body(state->scene, 0), button,
-                   platform_handler, NULL, 0, NULL);
+  body_set_category(button, BUTTON_CATEGORY);
   asset_make_button(DOOR_BUTTON_UNPRESSED_PATH, DOOR_BUTTON_PRESSED_PATH,
                     button);
 }
@@ -503,59 +628,47 @@ void make_level3(state_t *state) {
   for (size_t i = 1; i < 3; i++) {
     vector_t elevator_coord = (vector_t){ELEVATORS[i][0], ELEVATORS[i][1]};
     body_t *obstacle = make_obstacle(ELEVATORS[i][2], ELEVATORS[i][3],
-                                     elevator_coord, "elevator");
+                                     elevator_coord, elevator_kind);
+    body_set_type(obstacle, BODY_KINEMATIC);
     scene_add_body(state->scene, obstacle);
-    create_collision(state->scene, scene_get_body(state->scene, 0), obstacle,
-                     platform_handler, NULL, 0, NULL);
+    body_set_category(obstacle, PLATFORM_CATEGORY);
     asset_make_image_with_body(ELEVATOR_PATH, obstacle);
   }
 
   // make elevator button
   vector_t e_button_coord = (vector_t){E_BUTTONS[1][0], E_BUTTONS[1][1]};
-  body_t *e_button = make_obstacle(E_BUTTONS[1][2], E_BUTTONS[1][3],
-                                   e_button_coord, "elevator button");
+  body_t *e_button = make_sensor(E_BUTTONS[1][2], E_BUTTONS[1][3],
+                                 e_button_coord, elevator_button_kind);
   scene_add_body(state->scene, e_button);
-  create_collision(state->scene, scene_get_body(state->scene, 0), e_button,
-                   platform_handler, NULL, 0, NULL);
+  body_set_category(e_button, BUTTON_CATEGORY);
   asset_make_button(ELEVATOR_BUTTON_UNPRESSED_PATH,
                     ELEVATOR_BUTTON_PRESSED_PATH, e_button);
 
   // make door
   vector_t door_coord = (vector_t){DOORS[1][0], DOORS[1][1]};
-  body_t *door = make_obstacle(DOORS[1][2], DOORS[1][3], door_coord, "door");
+  body_t *door = make_obstacle(DOORS[1][2], DOORS[1][3], door_coord, door_kind);
   scene_add_body(state->scene, door);
-  create_collision(state->scene, scene_get_body(state->scene, 0), door,
-                   platform_handler, NULL, 0, NULL);
+  state->door = body_get_handle(door);
+  body_set_category(door, PLATFORM_CATEGORY);
   asset_make_image_with_body(DOOR_PATH, door);
 
   // make door button
   vector_t button_coord = (vector_t){BUTTONS[1][0], BUTTONS[1][1]};
   body_t *button =
-      make_obstacle(BUTTONS[1][2], BUTTONS[1][3], button_coord, "door button");
+      make_sensor(BUTTONS[1][2], BUTTONS[1][3], button_coord, door_button_kind);
   scene_add_body(state->scene, button);
-  create_collision(state->scene, scene_get_body(state->scene, 0), button,
-                   platform_handler, NULL, 0, NULL);
+  body_set_category(button, BUTTON_CATEGORY);
   asset_make_button(DOOR_BUTTON_UNPRESSED_PATH, DOOR_BUTTON_PRESSED_PATH,
                     button);
 
-  size_t brick_len = BRICK_NUM[2];
-  for (size_t i = 0; i < brick_len; i++) {
-    vector_t coord = (vector_t){BRICKS3[i][0], BRICKS3[i][1]};
-    body_t *obstacle =
-        make_obstacle(BRICKS3[i][2], BRICKS3[i][3], coord, "platform");
-    scene_add_body(state->scene, obstacle);
-    create_collision(state->scene, scene_get_body(state->scene, 0), obstacle,
-                     platform_handler, NULL, 0, NULL);
-    asset_make_image_with_body(BRICK_PATH, obstacle);
-  }
+  make_platforms(state, BRICKS3, BRICK_NUM[2]);
 
   size_t lava_len = LAVA_NUM[2];
   for (size_t i = 0; i < lava_len; i++) {
     vector_t coord = (vector_t){LAVA3[i][0], LAVA3[i][1]};
-    body_t *obstacle = make_obstacle(LAVA3[i][2], LAVA3[i][3], coord, "lava");
+    body_t *obstacle = make_sensor(LAVA3[i][2], LAVA3[i][3], coord, lava_kind);
     scene_add_body(state->scene, obstacle);
-    create_collision(state->scene, scene_get_body(state->scene, 0), obstacle,
-                     lose_handler, NULL, 0, NULL);
+    body_set_category(obstacle, LAVA_CATEGORY);
     asset_make_anim(LAVA1_PATH, LAVA2_PATH, LAVA3_PATH, obstacle);
   }
 
@@ -563,7 +676,7 @@ void make_level3(state_t *state) {
   for (size_t i = 0; i < water_len; i++) {
     vector_t coord = (vector_t){WATER3[i][0], WATER3[i][1]};
     body_t *obstacle =
-        make_obstacle(WATER3[i][2], WATER3[i][3], coord, "water");
+        make_sensor(WATER3[i][2], WATER3[i][3], coord, water_kind);
     scene_add_body(state->scene, obstacle);
     asset_make_anim(WATER1_PATH, WATER2_PATH, WATER3_PATH, obstacle);
   }
@@ -573,17 +686,15 @@ void make_level3(state_t *state) {
     vector_t center = (vector_t){GEM3[i][0], GEM3[i][1]};
     body_t *gem = make_gem(OUTER_RADIUS, INNER_RADIUS, center);
     scene_add_body(state->scene, gem);
-    create_collision(state->scene, scene_get_body(state->scene, 0), gem,
-                     gem_user_handler, NULL, 0, NULL);
+    body_set_category(gem, GEM_CATEGORY);
     asset_make_image_with_body(GEM_PATH, gem);
   }
 
   // make exit
   vector_t coord = (vector_t){EXITS[2][0], EXITS[2][1]};
-  body_t *exit = make_obstacle(EXITS[2][2], EXITS[2][3], coord, "exit");
+  body_t *exit = make_sensor(EXITS[2][2], EXITS[2][3], coord, exit_kind);
   scene_add_body(state->scene, exit);
-  create_collision(state->scene, scene_get_body(state->scene, 0), exit,
-                   win_handler, NULL, 0, NULL);
+  body_set_category(exit, EXIT_CATEGORY);
   asset_make_image_with_body(EXIT_DOOR_PATH, exit);
 }
 
@@ -596,6 +707,9 @@ void go_to_level(state_t *state, screen_t target_screen,
   state->scene = scene_init();
   state->current_screen = target_screen;
   state->elevator = false;
+  state->door = (body_handle_t){0};
+  state->gems_collected = 0;
+  state->tick_time = 0;
   sdl_reset_timer();
   make_level(state);
 }
@@ -638,7 +752,8 @@ void pause(state_t *state) {
 void unpause(state_t *state) {
   state->pause = false;
   list_t *asset_list = asset_get_asset_list();
-  list_remove(asset_list, list_size(asset_list) - 1);
+  // free the pause pop-up so its slot can be reused
+  asset_destroy(list_remove(asset_list, list_size(asset_list) - 1));
   sdl_reset_timer();
 }
 
@@ -677,11 +792,10 @@ void on_key(char key, key_event_type_t type, double held_time, state_t *state) {
       }
     }
   } else {
-    list_t *asset_list = asset_get_asset_list();
     collision_type_t collision_type = state->collision_type;
     body_t *spirit = scene_get_body(state->scene, 0);
     vector_t velocity = body_get_velocity(spirit);
-    asset_t *spirit_asset = list_get(asset_list, 1);
+    asset_t *spirit_asset = asset_find_by_body(spirit, ASSET_SPIRIT);
     if (type == KEY_PRESSED) {
       if (!state->pause) {
         switch (key) {
@@ -690,18 +804,14 @@ void on_key(char key, key_event_type_t type, double held_time, state_t *state) {
           break;
         }
         case LEFT_ARROW: {
-          if (!(collision_type == RIGHT_COLLISION ||
-                collision_type == UP_RIGHT_COLLISION ||
-                collision_type == DOWN_RIGHT_COLLISION)) {
+          if (!(collision_type & RIGHT_COLLISION)) {
             body_set_velocity(spirit, (vector_t){VELOCITY_LEFT.x, velocity.y});
           }
           asset_change_texture(spirit_asset, key);
           break;
         }
         case RIGHT_ARROW: {
-          if (!(collision_type == LEFT_COLLISION ||
-                collision_type == UP_LEFT_COLLISION ||
-                collision_type == DOWN_LEFT_COLLISION)) {
+          if (!(collision_type & LEFT_COLLISION)) {
             body_set_velocity(spirit, (vector_t){VELOCITY_RIGHT.x, velocity.y});
           }
           asset_change_texture(spirit_asset, key);
@@ -709,9 +819,7 @@ void on_key(char key, key_event_type_t type, double held_time, state_t *state) {
         }
         case UP_ARROW: {
           sdl_play_jump_sound(JUMP_SOUND_PATH);
-          if (collision_type == UP_COLLISION ||
-              collision_type == UP_LEFT_COLLISION ||
-              collision_type == UP_RIGHT_COLLISION) {
+          if (collision_type & UP_COLLISION) {
             body_set_velocity(spirit, (vector_t){velocity.x, VELOCITY_UP.y});
             break;
           }
@@ -759,113 +867,61 @@ void on_key(char key, key_event_type_t type, double held_time, state_t *state) {
   }
 }
 
-void button_action(state_t *state, body_t *button) {
-  list_t *asset_list = asset_get_asset_list();
-  for (size_t i = 0; i < list_size(asset_list); i++) {
-    asset_t *asset = list_get(asset_list, i);
-    if (asset->type == ASSET_IMAGE) {
-      image_asset_t *obstacle = (image_asset_t *)asset;
-      body_t *body = obstacle->body;
-      if ((strcmp(body_get_info(button), "door button") == 0 &&
-           strcmp(body_get_info(body), "door") == 0)) {
-        asset_remove_body(body);
-        body_remove(body);
-        break;
-      } else if (strcmp(body_get_info(button), "elevator button") == 0 &&
-                 strcmp(body_get_info(body), "elevator") == 0) {
-        state->elevator = true;
-      }
-    }
-  }
-}
-
-void button_press(state_t *state) {
-  body_t *spirit = scene_get_body(state->scene, 0);
-  list_t *asset_list = asset_get_asset_list();
-  for (size_t i = 0; i < list_size(asset_list); i++) {
-    asset_t *asset = list_get(asset_list, i);
-    if (asset->type == ASSET_BUTTON) {
-      button_asset_t *button_asset = (button_asset_t *)asset;
-      body_t *button = button_asset->body;
-      if (find_collision(spirit, button).collided) {
-        asset_change_texture_button((asset_t *)button_asset);
-        button_action(state, button);
-      }
-    }
-  }
-}
-
 void apply_gravity(state_t *state, double dt) {
   body_t *spirit = scene_get_body(state->scene, 0);
   vector_t spirit_velocity = body_get_velocity(spirit);
-  if (!(state->collision_type == UP_COLLISION ||
-        state->collision_type == UP_LEFT_COLLISION ||
-        state->collision_type == UP_RIGHT_COLLISION)) {
+  if (!(state->collision_type & UP_COLLISION)) {
     body_set_velocity(spirit, (vector_t){spirit_velocity.x,
                                          spirit_velocity.y - (GRAVITY * dt)});
   }
 }
 
+// sends an elevator back the other way once it has passed either end of its
+// range, given as {top, bottom}
+void turn_elevator(body_t *elevator, const size_t range[2]) {
+  double y = body_get_centroid(elevator).y;
+  if (y > range[0] + ELEVATOR_SLACK) {
+    body_set_velocity(elevator, ELEVATOR_DOWN);
+  } else if (y < range[1] - ELEVATOR_SLACK) {
+    body_set_velocity(elevator, ELEVATOR_UP);
+  }
+}
+
 // levels 2 and 3 have elevators
 void move_elevator(state_t *state) {
-  for (size_t i = 0; i < scene_bodies(state->scene); i++) {
-    body_t *spirit = scene_get_body(state->scene, 0);
-    body_t *body = scene_get_body(state->scene, i);
-    if (strcmp(body_get_info(body), "elevator") == 0) {
-      vector_t centroid = body_get_centroid(body);
-
-      if (state->current_screen == LEVEL2) {
-        if (centroid.y > ELEVATOR_RANGES[0][0]) {
-          body_set_velocity(body, ELEVATOR_DOWN);
-        } else if (centroid.y < ELEVATOR_RANGES[0][1]) {
-          body_set_velocity(body, ELEVATOR_UP);
-        }
-      }
+  body_t *spirit = scene_get_body(state->scene, 0);
+  for (size_t i = 0; i < scene_kind_bodies(state->scene, elevator_kind); i++) {
+    body_t *body = scene_get_kind_body(state->scene, elevator_kind, i);
+    vector_t centroid = body_get_centroid(body);
 
-      if (state->current_screen == LEVEL3) {
-        if (centroid.x == ELEVATORS[1][0]) { // first elevator
-          if (centroid.y > ELEVATOR_RANGES[1][0]) {
-            body_set_velocity(body, ELEVATOR_DOWN);
-          } else if (centroid.y < ELEVATOR_RANGES[1][1]) {
-            body_set_velocity(body, ELEVATOR_UP);
-          }
-        } else if (centroid.x == ELEVATORS[2][0]) { // second elevator
-          if (centroid.y > ELEVATOR_RANGES[2][0]) {
-            body_set_velocity(body, ELEVATOR_DOWN);
-          } else if (centroid.y < ELEVATOR_RANGES[2][1]) {
-            body_set_velocity(body, ELEVATOR_UP);
-          }
-        }
+    if (state->current_screen == LEVEL2) {
+      turn_elevator(body, ELEVATOR_RANGES[0]);
+    }
+
+    if (state->current_screen == LEVEL3) {
+      if (centroid.x == ELEVATORS[1][0]) { // first elevator
+        turn_elevator(body, ELEVATOR_RANGES[1]);
+      } else if (centroid.x == ELEVATORS[2][0]) { // second elevator
+        turn_elevator(body, ELEVATOR_RANGES[2]);
       }
+    }
 
-      if (find_collision(body, spirit).collided &&
-          (state->collision_type == UP_COLLISION ||
-           state->collision_type == UP_LEFT_COLLISION ||
-           state->collision_type == UP_RIGHT_COLLISION)) {
-        vector_t spirit_vel = body_get_velocity(spirit);
-        vector_t elevator_vel = body_get_velocity(body);
-        if (spirit_vel.y <= elevator_vel.y) {
-          body_set_velocity(spirit, (vector_t){body_get_velocity(spirit).x,
-                                               body_get_velocity(body).y});
-        }
+    // only carry the spirit when it is standing on top of the elevator
+    contact_manifold_t contact;
+    if (find_collision_with_manifold(spirit, body, &contact).collided &&
+        contact.face == UP_COLLISION) {
+      vector_t spirit_vel = body_get_velocity(spirit);
+      vector_t elevator_vel = body_get_velocity(body);
+      if (spirit_vel.y <= elevator_vel.y) {
+        body_set_velocity(spirit, (vector_t){body_get_velocity(spirit).x,
+                                             body_get_velocity(body).y});
       }
     }
   }
 }
 
 void update_points(state_t *state) {
-  size_t gem_counter = 3;
-  list_t *asset_list = asset_get_asset_list();
-  for (size_t i = 0; i < list_size(asset_list); i++) {
-    asset_t *asset = list_get(asset_list, i);
-    if (asset->type == ASSET_IMAGE) {
-      image_asset_t *gem_asset = (image_asset_t *)asset;
-      body_t *gem = gem_asset->body;
-      if (strcmp(body_get_info(gem), "gem") == 0) {
-        gem_counter--;
-      }
-    }
-  }
+  size_t gem_counter = state->gems_collected;
 
   double score = pow(gem_counter, 2) * (60 / state->time);
 
@@ -875,83 +931,189 @@ void update_points(state_t *state) {
   }
 }
 
-// to check if the levels have been completed or not
-void level_complete(state_t *state) {
-  body_t *spirit = scene_get_body(state->scene, 0);
-  list_t *asset_list = asset_get_asset_list();
-  for (size_t i = 0; i < list_size(asset_list); i++) {
-    asset_t *asset = list_get(asset_list, i);
-    if (asset->type == ASSET_IMAGE) {
-      image_asset_t *obstacle = (image_asset_t *)asset;
-      body_t *body = obstacle->body;
-      if ((strcmp(body_get_info(body), "exit")) == 0 &&
-          find_collision(spirit, body).collided) {
-        state->level_completed[state->current_screen - 1] = true;
-      }
-    }
-  }
+// bodies the spirit can stand on or be blocked by
+bool is_platform(body_t *body) {
+  return body_get_category(body) & PLATFORM_CATEGORY;
 }
 
 collision_type_t collision(state_t *state) {
   body_t *spirit = scene_get_body(state->scene, 0);
-  scene_t *scene = state->scene;
   collision_type_t res = NO_COLLISION;
 
-  for (size_t i = 1; i < scene_bodies(scene); i++) {
-    body_t *platform = scene_get_body(scene, i);
-
-    if ((strcmp(body_get_info(platform), "platform") != 0) &&
-        (strcmp(body_get_info(platform), "elevator") != 0) &&
-        (strcmp(body_get_info(platform), "door") != 0) &&
-        (strcmp(body_get_info(platform), "door button") != 0) &&
-        (strcmp(body_get_info(platform), "elevator button") != 0)) {
-      continue;
+  // probe just past the spirit in each direction for a platform;
+  // the downward probe is the ground check
+  for (size_t i = 0; i < NUM_CONTACT_PROBES; i++) {
+    scene_hit_t hit = scene_shape_cast(state->scene, spirit, CONTACT_PROBES[i],
+                                       CONTACT_DISTANCE, is_platform);
+    if (hit.hit) {
+      res |= collision_face(vec_negate(hit.normal));
     }
+  }
+  return res;
+}
 
-    if (!find_collision(spirit, platform).collided) {
-      continue;
-    }
+// advances a level by one tick
+void tick_level(state_t *state, double dt) {
+  state->collision_type = collision(state);
 
-    vector_t cen = body_get_centroid(spirit);
-    list_t *pts = body_get_shape(platform);
-    vector_t *v1 = list_get(pts, 0); // bottom left
-    vector_t *v2 = list_get(pts, 1); // bottom right
-    vector_t *v3 = list_get(pts, 2); // top right
-    vector_t *v4 = list_get(pts, 3); // top left
+  // gravity
+  apply_gravity(state, dt);
 
-    if (cen.x > v4->x - INNER_RADIUS && cen.x < v3->x + INNER_RADIUS &&
-        cen.y - (INNER_RADIUS - 8) >= v4->y) {
-      res += UP_COLLISION;
-      continue;
-    }
-    if (cen.x > v1->x - INNER_RADIUS && cen.x < v2->x + INNER_RADIUS &&
-        cen.y < v1->y) {
-      res += DOWN_COLLISION;
-      continue;
+  if (state->elevator) {
+    move_elevator(state);
+  }
+
+  update_points(state);
+
+  scene_tick(state->scene, dt);
+  // drop the sprites of the bodies the tick removed
+  size_t num_removed;
+  const body_handle_t *removed =
+      scene_get_removed(state->scene, &num_removed);
+  asset_flush_removed(removed, num_removed);
+  state->time += dt;
+}
+
+// sets how many ticks the level is simulated in per second; more ticks cost
+// more time per frame but let fast bodies collide more precisely
+void set_tick_rate(state_t *state, double tick_rate) {
+  assert(tick_rate > 0);
+  state->tick_rate = tick_rate;
+}
+
+// runs the ticks that the time since the last frame covers, and returns how
+// far the frame is into the next tick, from 0 to 1
+double run_ticks(state_t *state, double frame_time) {
+  double tick_length = 1 / state->tick_rate;
+  state->tick_time += frame_time;
+  size_t ticks = state->tick_time / tick_length;
+  if (ticks > MAX_TICKS_PER_FRAME) {
+    // drop the time that cannot be caught up on, rather than falling further
+    // behind every frame
+    state->tick_time -= (ticks - MAX_TICKS_PER_FRAME) * tick_length;
+    ticks = MAX_TICKS_PER_FRAME;
+  }
+  size_t tick = 0;
+  for (; tick < ticks && !game_over; tick++) {
+    if (tick == ticks - 1) {
+      // the frame is drawn between the poses before and after the last tick
+      scene_save_poses(state->scene);
     }
-    if (cen.y > v1->y - OUTER_RADIUS && cen.y < v4->y + OUTER_RADIUS &&
-        cen.x < v1->x) {
-      res += LEFT_COLLISION;
-      continue;
+    tick_level(state, tick_length);
+    state->tick_time -= tick_length;
+  }
+  if (tick < ticks) {
+    // the level ended before the last tick, so no poses were saved this frame
+    // and the ones from earlier frames are stale; draw the bodies where they
+    // ended up instead
+    scene_save_poses(state->scene);
+  }
+  return fmin(state->tick_time / tick_length, 1);
+}
+
+// FRAME SYSTEMS
+
+// runs the level's ticks for the time since the last frame
+void simulate_system(state_t *state) {
+  state->running =
+      state->current_screen != HOMEPAGE && !state->pause && !game_over;
+  if (state->current_screen != HOMEPAGE) {
+    double dt = time_since_last_tick();
+    if (state->running) {
+      sdl_set_interpolation(run_ticks(state, dt));
     }
-    if (cen.y > v2->y - OUTER_RADIUS && cen.y < v3->y + OUTER_RADIUS &&
-        cen.x > v2->x) {
-      res += RIGHT_COLLISION;
-      continue;
+  }
+}
+
+void music_system(state_t *state) { sdl_play_music(BACKGROUND_MUSIC_PATH); }
+
+void animate_system(state_t *state) {
+  list_t *assets = asset_get_asset_list();
+  for (size_t i = 0; i < list_size(assets); i++) {
+    asset_animate(list_get(assets, i), state->time);
+  }
+}
+
+// finds where each asset is drawn, so draw_system() only has to draw them
+void prepare_render_list_system(state_t *state) {
+  render_list_clear(&state->render_list);
+  list_t *assets = asset_get_asset_list();
+  for (size_t i = 0; i < list_size(assets); i++) {
+    asset_t *asset = list_get(assets, i);
+    SDL_Rect box;
+    if (asset_get_render_box(asset, &box)) {
+      render_list_add(&state->render_list,
+                      (render_item_t){.asset = asset, .box = box});
     }
   }
-  return res;
 }
 
-state_t *emscripten_init() {
+void prepare_clock_system(state_t *state) {
+  snprintf(state->clock_text, sizeof(state->clock_text), "Clock:%.0f",
+           floor(state->time));
+  vector_t text_dim = get_dimensions_for_text(state->clock_text);
+  state->clock_rect = (SDL_Rect){.x = CLOCK_POS.x - (text_dim.x / 2),
+                                 .y = CLOCK_POS.y,
+                                 .w = text_dim.x,
+                                 .h = text_dim.y};
+}
+
+void draw_system(state_t *state) {
+  sdl_clear();
+  sdl_render_scene(state->scene);
+  for (size_t i = 0; i < state->render_list.size; i++) {
+    render_item_t *item = &state->render_list.data[i];
+    asset_render_in(item->asset, &item->box);
+  }
+  if (state->running) {
+    sdl_render_text(state->clock_text, state->font, CLOCK_COL,
+                    &state->clock_rect);
+  }
+  sdl_show();
+}
+
+// the work of each frame, split into systems that declare what they use, so
+// the ones that do not share anything can run at the same time
+task_graph_t *init_frame(state_t *state) {
+  task_graph_t *frame = task_graph_init(0);
+  // the scene's threads must be started from the thread that ticks it, and
+  // its handlers play sounds and add pop-ups, so it ticks on the main thread
+  task_graph_add(frame, (task_system_t)simulate_system, state, 0,
+                 SCENE_RESOURCE | STATE_RESOURCE | ASSETS_RESOURCE |
+                     AUDIO_RESOURCE,
+                 true);
+  // SDL_mixer is not thread-safe, so music is started on the main thread too
+  task_graph_add(frame, (task_system_t)music_system, state, 0, AUDIO_RESOURCE,
+                 true);
+  task_graph_add(frame, (task_system_t)animate_system, state, STATE_RESOURCE,
+                 ASSETS_RESOURCE, false);
+  task_graph_add(frame, (task_system_t)prepare_clock_system, state,
+                 STATE_RESOURCE, CLOCK_RESOURCE, false);
+  task_graph_add(frame, (task_system_t)prepare_render_list_system, state,
+                 SCENE_RESOURCE | ASSETS_RESOURCE, RENDER_LIST_RESOURCE,
+                 false);
+  task_graph_add(frame, (task_system_t)draw_system, state,
+                 SCENE_RESOURCE | STATE_RESOURCE | ASSETS_RESOURCE |
+                     RENDER_LIST_RESOURCE | CLOCK_RESOURCE,
+                 SCREEN_RESOURCE, true);
+  return frame;
+}
+
+// sets up the game's state and the modules it uses, apart from the window;
+// the level check (tests/level_check.c) plays the levels from this state
+state_t *state_init() {
   asset_cache_init();
-  sdl_init(MIN, MAX);
+  init_shapes();
+  init_kinds();
   state_t *state = malloc(sizeof(state_t));
+  assert(state);
   state->scene = scene_init();
   state->current_screen = HOMEPAGE;
   state->collision_type = NO_COLLISION;
   state->pause = false;
   state->elevator = false;
+  state->door = (body_handle_t){0};
+  state->gems_collected = 0;
 
   for (size_t i = 0; i < NUMBER_OF_LEVELS; i++) {
     state->level_points[i] = 0.0;
@@ -959,7 +1121,33 @@ state_t *emscripten_init() {
   }
 
   state->time = 0;
+  state->tick_time = 0;
+  state->tick_rate = DEFAULT_TICK_RATE;
+  state->font = NULL;
+  state->frame = NULL;
+  state->running = false;
+  state->render_list = render_list_init(INIT_RENDER_ITEMS);
+  return state;
+}
+
+// frees what state_init() set up
+void state_free(state_t *state) {
+  render_list_free(&state->render_list);
+  asset_free_all();
+  scene_free(state->scene);
+  shape_template_release(square_shape);
+  shape_template_release(circle_shape);
+  asset_cache_destroy();
+  body_kinds_free();
+  body_store_free();
+  free(state);
+}
+
+state_t *emscripten_init() {
+  sdl_init(MIN, MAX);
+  state_t *state = state_init();
   state->font = TTF_OpenFont(FONT_FILEPATH, 18);
+  state->frame = init_frame(state);
 
   go_to_homepage(state);
   sdl_on_key((key_handler_t)on_key);
@@ -967,63 +1155,13 @@ state_t *emscripten_init() {
 }
 
 bool emscripten_main(state_t *state) {
-  sdl_clear();
-  sdl_render_scene(state->scene);
-  sdl_play_music(BACKGROUND_MUSIC_PATH);
-  list_t *body_assets = asset_get_asset_list();
-  size_t len = list_size(body_assets);
-
-  for (size_t i = 0; i < len; i++) {
-    asset_t *asset = list_get(body_assets, i);
-    asset_animate(asset, state->time);
-    asset_animate(asset, state->time);
-    asset_render(list_get(body_assets, i));
-  }
-
-  if (state->current_screen != HOMEPAGE) {
-    double dt = time_since_last_tick();
-    if (!(state->pause) && !(game_over) && dt < 0.1) {
-
-      // timer
-      char text[10000];
-      sprintf(text, "Clock:%.0f", floor(state->time));
-      vector_t text_dim = get_dimensions_for_text(text);
-      SDL_Rect rect = (SDL_Rect){.x = CLOCK_POS.x - (text_dim.x / 2),
-                                 .y = CLOCK_POS.y,
-                                 .w = text_dim.x,
-                                 .h = text_dim.y};
-
-      sdl_render_text(text, state->font, CLOCK_COL, &rect);
-      state->collision_type = collision(state);
-
-      // gravity
-      apply_gravity(state, dt);
-
-      // check for pressed buttons
-      button_press(state);
-
-      if (state->elevator) {
-        move_elevator(state);
-      }
-
-      // check for completed level
-      level_complete(state);
-
-      update_points(state);
-
-      scene_tick(state->scene, dt);
-      state->time += dt;
-    }
-  }
-  sdl_show();
+  task_graph_run(state->frame);
   return false;
 }
 
 void emscripten_free(state_t *state) {
-  sdl_quit();
-  list_free(asset_get_asset_list());
-  scene_free(state->scene);
-  asset_cache_destroy();
+  task_graph_free(state->frame);
   TTF_CloseFont(state->font);
-  free(state);
+  state_free(state);
+  sdl_quit();
 }
@@ -0,0 +1,112 @@
+#ifndef __ARRAY_H__
+#define __ARRAY_H__
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vector.h"
+
+/**
+ * Defines a growable array that stores values of a plain type contiguously,
+ * unlike list_t, which stores pointers to separately allocated values.
+ * The array is a struct passed by pointer, and all its functions are inline,
+ * so reading an element is a single load.
+ *
+ * ARRAY_DEFINE(name, type) defines:
+ * - name_t, a struct with fields `type *data`, `size_t size` and
+ *   `size_t capacity`, which may be read directly
+ * - name_t name_init(size_t capacity): an empty array with space for capacity
+ *   elements. Asserts that the required memory is allocated.
+ * - name_t name_from(const type *values, size_t count): an array holding a
+ *   copy of count values
+ * - void name_reserve(name_t *array, size_t capacity): makes space for at
+ *   least capacity elements
+ * - void name_add(name_t *array, type value): appends a value, growing the
+ *   array if it is full
+ * - type name_get(const name_t *array, size_t index): the value at an index.
+ *   Asserts that the index is valid.
+ * - void name_set(name_t *array, size_t index, type value)
+ * - void name_remove(name_t *array, size_t index): removes the value at an
+ *   index, moving the later values down. Asserts that the index is valid.
+ * - void name_clear(name_t *array): removes every value, keeping the memory
+ * - void name_free(name_t *array): releases the memory; the array is empty
+ *   afterwards
+ *
+ * @param name the prefix of the type and function names
+ * @param type the element type, which must be safe to copy with memcpy()
+ */
+#define ARRAY_DEFINE(name, type)                                               \
+  typedef struct {                                                             \
+    type *data;                                                                \
+    size_t size;                                                               \
+    size_t capacity;                                                           \
+  } name##_t;                                                                  \
+                                                                               \
+  static inline name##_t name##_init(size_t capacity) {                        \
+    if (capacity == 0) {                                                       \
+      capacity = 1;                                                            \
+    }                                                                          \
+    name##_t array = {.data = malloc(sizeof(type) * capacity),                 \
+                      .size = 0,                                               \
+                      .capacity = capacity};                                   \
+    assert(array.data);                                                        \
+    return array;                                                              \
+  }                                                                            \
+                                                                               \
+  static inline name##_t name##_from(const type *values, size_t count) {       \
+    name##_t array = name##_init(count);                                       \
+    memcpy(array.data, values, sizeof(type) * count);                          \
+    array.size = count;                                                        \
+    return array;                                                              \
+  }                                                                            \
+                                                                               \
+  static inline void name##_reserve(name##_t *array, size_t capacity) {        \
+    if (capacity <= array->capacity) {                                         \
+      return;                                                                  \
+    }                                                                          \
+    array->data = realloc(array->data, sizeof(type) * capacity);               \
+    assert(array->data);                                                       \
+    array->capacity = capacity;                                                \
+  }                                                                            \
+                                                                               \
+  static inline void name##_add(name##_t *array, type value) {                 \
+    if (array->size == array->capacity) {                                      \
+      name##_reserve(array, array->capacity > 0 ? array->capacity * 2 : 1);    \
+    }                                                                          \
+    array->data[array->size++] = value;                                        \
+  }                                                                            \
+                                                                               \
+  static inline type name##_get(const name##_t *array, size_t index) {         \
+    assert(index < array->size);                                               \
+    return array->data[index];                                                 \
+  }                                                                            \
+                                                                               \
+  static inline void name##_set(name##_t *array, size_t index, type value) {   \
+    assert(index < array->size);                                               \
+    array->data[index] = value;                                                \
+  }                                                                            \
+                                                                               \
+  static inline void name##_remove(name##_t *array, size_t index) {           \
+    assert(index < array->size);                                               \
+    memmove(&array->data[index], &array->data[index + 1],                      \
+            sizeof(type) * (array->size - index - 1));                         \
+    array->size--;                                                             \
+  }                                                                            \
+                                                                               \
+  static inline void name##_clear(name##_t *array) { array->size = 0; }        \
+                                                                               \
+  static inline void name##_free(name##_t *array) {                            \
+    free(array->data);                                                         \
+    array->data = NULL;                                                        \
+    array->size = 0;                                                           \
+    array->capacity = 0;                                                       \
+  }
+
+/**
+ * A growable array of vectors, e.g. the vertices of a shape.
+ * See ARRAY_DEFINE() for its functions, such as vector_array_add().
+ */
+ARRAY_DEFINE(vector_array, vector_t)
+
+#endif // #ifndef __ARRAY_H__
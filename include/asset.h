@@ -17,9 +17,22 @@ typedef enum {
   ASSET_BUTTON,
 } asset_type_t;
 
+/**
+ * A reference to an asset that can safely outlive it: once the asset is
+ * destroyed, asset_from_handle() returns NULL for it.
+ * The handle with generation 0 refers to no asset.
+ */
+typedef struct {
+  uint32_t slot;
+  uint32_t generation;
+} asset_handle_t;
+
 typedef struct asset {
   asset_type_t type;
   SDL_Rect bounding_box;
+  asset_handle_t handle;
+  // the body the asset is drawn on, if any; read it with asset_get_body()
+  body_handle_t body;
 } asset_t;
 
 typedef struct text_asset {
@@ -32,7 +45,6 @@ typedef struct text_asset {
 typedef struct image_asset {
   asset_t base;
   SDL_Texture *texture;
-  body_t *body;
 } image_asset_t;
 
 typedef struct spirit_asset {
@@ -41,7 +53,6 @@ typedef struct spirit_asset {
   SDL_Texture *front_texture;
   SDL_Texture *right_texture;
   SDL_Texture *left_texture;
-  body_t *body;
 } spirit_asset_t;
 
 typedef struct anim_asset {
@@ -50,7 +61,6 @@ typedef struct anim_asset {
   SDL_Texture *frame1_texture;
   SDL_Texture *frame2_texture;
   SDL_Texture *frame3_texture;
-  body_t *body;
 } anim_asset_t;
 
 typedef struct button_asset {
@@ -58,7 +68,6 @@ typedef struct button_asset {
   SDL_Texture *curr_texture;
   SDL_Texture *unpressed_texture;
   SDL_Texture *pressed_texture;
-  body_t *body;
 } button_asset_t;
 
 /**
@@ -142,6 +151,13 @@ void asset_animate(asset_t *asset, double time);
  */
 void asset_reset_asset_list();
 
+/**
+ * Destroys every asset and releases the tables that index them by handle and
+ * by body. Handles to destroyed assets may match assets created afterwards.
+ * Call it when the game exits.
+ */
+void asset_free_all();
+
 /**
  * Allocates memory for an button asset with the given parameters and
  * adds it to the internal asset list.
@@ -168,14 +184,90 @@ void asset_change_texture_button(asset_t *asset);
 list_t *asset_get_asset_list();
 
 /**
- * Removes and destroys all image assets associated with the given body.
- * This is typically called when a body is destroyed to clean up its visual
- * representation.
+ * Gets a handle to an asset.
+ *
+ * @param asset the asset
+ * @return a handle that refers to the asset until it is destroyed
+ */
+asset_handle_t asset_get_handle(asset_t *asset);
+
+/**
+ * Finds the asset a handle refers to, in constant time.
+ *
+ * @param handle a handle returned from asset_get_handle()
+ * @return the asset, or NULL if it has been destroyed or the handle refers to
+ * no asset
+ */
+asset_t *asset_from_handle(asset_handle_t handle);
+
+/**
+ * Gets the body an asset is drawn on.
+ *
+ * @param asset the asset
+ * @return the body, or NULL if the asset has no body or its body was freed
+ */
+body_t *asset_get_body(asset_t *asset);
+
+/**
+ * Finds an asset of a given type drawn on a body.
+ * Takes time proportional to the number of assets on the body, rather than
+ * to the number of assets.
+ *
+ * @param body the body
+ * @param type the type of asset to look for
+ * @return the first such asset created, or NULL if there is none
+ */
+asset_t *asset_find_by_body(body_t *body, asset_type_t type);
+
+/**
+ * Marks all image assets associated with the given body for removal.
+ * asset_flush_removed() already removes the images of bodies the scene has
+ * freed, so this is only needed to take the images off a body that stays in
+ * the scene.
+ * The assets stay in the asset list, so it is safe to call while iterating
+ * over it, until asset_flush_removed() destroys them.
+ * Takes time proportional to the number of assets on the body.
  *
  * @param body the body whose associated assets should be removed
  */
 void asset_remove_body(body_t *body);
 
+/**
+ * Removes and destroys the assets marked by asset_remove_body(), and the
+ * image assets of the given bodies, keeping the others in order.
+ * Only the given bodies' assets are looked at, so this takes constant time
+ * when there is nothing to remove, and otherwise time proportional to the
+ * number of assets.
+ * Call it once per frame after scene_tick(), with the bodies from
+ * scene_get_removed(); until then, assets whose bodies have been freed are not
+ * rendered.
+ *
+ * @param bodies handles to the bodies that have been freed
+ * @param count the number of handles
+ */
+void asset_flush_removed(const body_handle_t *bodies, size_t count);
+
+/**
+ * Finds where an asset is drawn on the screen: on its body's bounding box if
+ * it has a body, otherwise its own bounding box.
+ * Only reads the asset and its body, so it can be called off the main thread
+ * while neither is changing.
+ *
+ * @param asset the asset to place
+ * @param box set to where the asset is drawn
+ * @return whether the asset should be drawn, i.e. it has no body or its body
+ * has not been freed
+ */
+bool asset_get_render_box(asset_t *asset, SDL_Rect *box);
+
+/**
+ * Renders the asset to the screen in a given box,
+ * e.g. one found by asset_get_render_box().
+ * @param asset the asset to render
+ * @param box where to draw the asset
+ */
+void asset_render_in(asset_t *asset, SDL_Rect *box);
+
 /**
  * Renders the asset to the screen.
  * @param asset the asset to render
@@ -184,6 +276,7 @@ void asset_render(asset_t *asset);
 
 /**
  * Frees the memory allocated for the asset.
+ * Handles to it no longer refer to any asset.
  * @param asset the asset to free
  */
 void asset_destroy(asset_t *asset);
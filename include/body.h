@@ -2,7 +2,9 @@
 #define __BODY_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 
+#include "array.h"
 #include "color.h"
 #include "list.h"
 #include "vector.h"
@@ -10,9 +12,116 @@
 /**
  * A rigid body constrained to the plane.
  * Implemented as a polygon with uniform density.
+ * Bodies are handles: the data used each tick (positions, velocities, forces,
+ * masses, bounding boxes and vertices) is kept in arrays shared by all bodies,
+ * so that it can be read in order when many bodies are simulated.
+ * A body's shape is kept relative to its centroid; its vertices, edge normals
+ * and bounding box in the scene are only recomputed when they are read after
+ * it moves or rotates. So reading them is not thread-safe unless they have
+ * already been read since the body last changed.
  */
 typedef struct body body_t;
 
+/**
+ * A reference to a body that, unlike a body_t pointer, can safely outlive the
+ * body: once the body is freed, body_from_handle() returns NULL for it.
+ * The handle with generation 0 (e.g. `(body_handle_t){0}`) refers to no body.
+ */
+typedef struct {
+  /** Where the body's state is stored */
+  uint32_t slot;
+  /** How many bodies had used the slot when the body was created */
+  uint32_t generation;
+} body_handle_t;
+
+/**
+ * What a body is in the game, e.g. a platform or a door, as an integer that
+ * is cheap to compare. Names are mapped to kinds with body_kind_intern().
+ * Kind 0 (BODY_KIND_NONE) is the kind of bodies that were never given one.
+ */
+typedef uint32_t body_kind_t;
+
+#define BODY_KIND_NONE ((body_kind_t)0)
+
+/**
+ * An axis-aligned bounding box.
+ */
+typedef struct {
+  /** The corner with the smallest coordinates */
+  vector_t min;
+  /** The corner with the largest coordinates */
+  vector_t max;
+} aabb_t;
+
+/**
+ * How a body moves.
+ */
+typedef enum {
+  /** Moved by forces, impulses and its velocity. The default. */
+  BODY_DYNAMIC,
+  /**
+   * Moved only by its velocity, e.g. an elevator.
+   * Forces and impulses on it are ignored.
+   */
+  BODY_KINEMATIC,
+  /**
+   * Never moves during a tick, e.g. a platform.
+   * Forces and impulses on it are ignored, and scenes never check whether two
+   * static bodies touch.
+   */
+  BODY_STATIC,
+} body_type_t;
+
+/**
+ * A read-only view of a body's vertices, borrowed from the body.
+ * It stays valid until the body is next moved, rotated or freed, or another
+ * body is created.
+ */
+typedef struct {
+  /**
+   * The vertices of the shape, in order around it, as the simulation stores
+   * them; read them with vec_from_sim()
+   */
+  const sim_vector_t *vertices;
+  /** The number of vertices */
+  size_t count;
+} shape_view_t;
+
+/**
+ * An immutable polygon that many bodies can share, e.g. the rectangle every
+ * platform is made from.
+ * Templates are reference counted: each body made from one holds a
+ * reference, so the program can release its own as soon as it has made the
+ * bodies it needs.
+ */
+typedef struct shape_template shape_template_t;
+
+/**
+ * Allocates a shape template, copying its vertices.
+ * The caller holds the only reference to it.
+ * Asserts that the required memory is allocated.
+ *
+ * @param vertices the vertices of the polygon, in order around it
+ * @return a pointer to the new template
+ */
+shape_template_t *shape_template_init(const vector_array_t *vertices);
+
+/**
+ * Adds a reference to a shape template.
+ *
+ * @param shape a pointer to a template returned from shape_template_init()
+ * @return the template, for convenience
+ */
+shape_template_t *shape_template_retain(shape_template_t *shape);
+
+/**
+ * Drops a reference to a shape template, freeing it once no references to
+ * it are left.
+ *
+ * @param shape a pointer to a template returned from shape_template_init()
+ */
+void shape_template_release(shape_template_t *shape);
+
 /**
  * Initializes a body without any info.
  * Acts like body_init_with_info() where info and info_freer are NULL.
@@ -22,7 +131,8 @@ body_t *body_init(list_t *shape, double mass, color_t color);
 
 /**
  * Allocates memory for a body with the given parameters.
- * Gains ownership of the shape list.
+ * Gains ownership of the shape list, which is freed once its vertices have
+ * been copied into the body.
  * The body is initially at rest.
  * Asserts that the required memory is allocated.
  *
@@ -37,6 +147,44 @@ body_t *body_init(list_t *shape, double mass, color_t color);
 body_t *body_init_with_info(list_t *shape, double mass, color_t color,
                             void *info, free_func_t info_freer);
 
+/**
+ * Allocates memory for a body with the given parameters,
+ * copying its shape from an array of vertices.
+ * Acts like body_init_with_info(), but does not take ownership of the shape,
+ * which may be reused or freed afterwards.
+ *
+ * @param shape the vertices of the initial shape of the body
+ * @param mass the mass of the body (if INFINITY, stops the body from moving)
+ * @param color the color of the body, used to draw it on the screen
+ * @param info additional information to associate with the body
+ * @param info_freer if non-NULL, a function call on the info to free it
+ * @return a pointer to the newly allocated body
+ */
+body_t *body_init_with_shape(const vector_array_t *shape, double mass,
+                             color_t color, void *info,
+                             free_func_t info_freer);
+
+/**
+ * Allocates memory for a body whose shape is a template, stretched by a
+ * scale, without copying the template's vertices. The body holds a reference
+ * to the template until it is freed.
+ * The body's vertices start where the template's vertices would be after
+ * scaling them about (0, 0), and the body is initially at rest.
+ * Asserts that the required memory is allocated.
+ *
+ * @param shape a pointer to a template returned from shape_template_init()
+ * @param scale the factors to multiply the template's x and y coordinates by;
+ * both must be positive
+ * @param mass the mass of the body (if INFINITY, stops the body from moving)
+ * @param color the color of the body, used to draw it on the screen
+ * @param info additional information to associate with the body
+ * @param info_freer if non-NULL, a function call on the info to free it
+ * @return a pointer to the newly allocated body
+ */
+body_t *body_init_with_template(shape_template_t *shape, vector_t scale,
+                                double mass, color_t color, void *info,
+                                free_func_t info_freer);
+
 /**
  * Gets the current shape of a body.
  * Returns a newly allocated vector list, which must be list_free()d.
@@ -46,6 +194,38 @@ body_t *body_init_with_info(list_t *shape, double mass, color_t color,
  */
 list_t *body_get_shape(body_t *body);
 
+/**
+ * Gets a view of the current shape of a body without copying it.
+ * Use this rather than body_get_shape() when the shape is only read.
+ *
+ * @param body the pointer to the body
+ * @return a view of the body's vertices; see shape_view_t for how long it
+ * stays valid
+ */
+shape_view_t body_get_shape_view(body_t *body);
+
+/**
+ * Gets the unit normals of the edges of a body's current shape, without
+ * copying them. Normal i belongs to the edge from vertex i to vertex i + 1,
+ * and is zero if the edge has no length.
+ * The normals point outwards if the vertices run counterclockwise.
+ *
+ * @param body the pointer to the body
+ * @return a view of the normals, valid for as long as a view from
+ * body_get_shape_view()
+ */
+shape_view_t body_get_edge_normals(body_t *body);
+
+/**
+ * Gets the bounding box of a body's current shape.
+ * The box is kept up to date as the body moves, so this does not visit its
+ * vertices.
+ *
+ * @param body the pointer to the body
+ * @return the smallest axis-aligned box containing the body
+ */
+aabb_t body_get_bounding_box(body_t *body);
+
 /**
  * Return the info associated with a body.
  *
@@ -130,10 +310,42 @@ double body_get_rotation(body_t *body);
  */
 void body_set_rotation(body_t *body, double angle);
 
+/**
+ * Records a body's current centroid and rotation as its previous pose,
+ * so that it can be drawn part of the way between two ticks.
+ * Until its pose is first saved, a body is drawn where it is.
+ *
+ * @param body the pointer to the body
+ */
+void body_save_pose(body_t *body);
+
+/**
+ * Gets where a body's centroid was part of the way from its previous pose
+ * (see body_save_pose()) to its current one.
+ *
+ * @param body the pointer to the body
+ * @param alpha how far to go, from 0 (the previous pose) to 1 (the current
+ * one)
+ * @return the interpolated centroid
+ */
+vector_t body_get_interpolated_centroid(body_t *body, double alpha);
+
+/**
+ * Gets a body's rotation part of the way from its previous pose
+ * (see body_save_pose()) to its current one.
+ *
+ * @param body the pointer to the body
+ * @param alpha how far to go, from 0 (the previous pose) to 1 (the current
+ * one)
+ * @return the interpolated rotation angle in radians
+ */
+double body_get_interpolated_rotation(body_t *body, double alpha);
+
 /**
  * Updates the body after a given time interval has elapsed.
  * Sets acceleration and velocity according to the forces and impulses
  * applied to the body during the tick.
+ * Static bodies do not move, and kinematic bodies move at their velocity.
  * The body is translated at the *average* of the velocities before
  * and after the tick.
  * Resets the forces and impulses accumulated on the body.
@@ -155,24 +367,45 @@ double body_get_mass(body_t *body);
  * Applies a force to a body over the current tick.
  * If multiple forces are applied in the same tick, they are added.
  * Does not change the body's position or velocity; see body_tick().
+ * Does nothing unless the body is dynamic.
+ * Wakes the body if the force is not zero.
  *
  * @param body the pointer to the body
  * @param force the force vector to apply
  */
 void body_add_force(body_t *body, vector_t force);
 
+/**
+ * Gets the total force applied to a body so far this tick.
+ *
+ * @param body the pointer to the body
+ * @return the sum of the forces passed to body_add_force() since the last tick
+ */
+vector_t body_get_force(body_t *body);
+
 /**
  * Applies an impulse to a body.
  * An impulse causes an instantaneous change in velocity,
  * which is useful for modeling collisions.
  * If multiple impulses are applied in the same tick, they are added.
  * Does not change the body's position or velocity; see body_tick().
+ * Does nothing unless the body is dynamic.
+ * Wakes the body if the impulse is not zero.
  *
  * @param body the pointer to the body
  * @param impulse the impulse vector to apply
  */
 void body_add_impulse(body_t *body, vector_t impulse);
 
+/**
+ * Gets the total impulse applied to a body so far this tick.
+ *
+ * @param body the pointer to the body
+ * @return the sum of the impulses passed to body_add_impulse() since the last
+ * tick
+ */
+vector_t body_get_impulse(body_t *body);
+
 /**
  * Clear the forces and impulses on the body.
  *
@@ -200,8 +433,207 @@ void body_remove(body_t *body);
  */
 bool body_is_removed(body_t *body);
 
+/**
+ * Sets how a body moves. See body_type_t.
+ * Scenes keep static bodies in a separate structure that they only rebuild
+ * when bodies are added or removed, so a body's type should be set before it
+ * is added to a scene, and a static body should not be moved afterwards;
+ * make it kinematic instead.
+ *
+ * @param body the pointer to the body
+ * @param type the body's new type
+ */
+void body_set_type(body_t *body, body_type_t type);
+
+/**
+ * Gets how a body moves.
+ *
+ * @param body the pointer to the body
+ * @return the type set by body_set_type()
+ */
+body_type_t body_get_type(body_t *body);
+
+/**
+ * Puts a body to sleep or wakes it up.
+ * Scenes do not tick sleeping bodies; see scene_set_sleeping().
+ * Putting a body to sleep stops it and clears its forces and impulses.
+ * Moving, rotating or setting the velocity of a body wakes it,
+ * as does applying a nonzero force or impulse.
+ *
+ * @param body the pointer to the body
+ * @param sleeping whether the body should sleep
+ */
+void body_set_sleeping(body_t *body, bool sleeping);
+
+/**
+ * Returns whether a body is asleep.
+ *
+ * @param body the pointer to the body
+ * @return whether the body is sleeping; see body_set_sleeping()
+ */
+bool body_is_sleeping(body_t *body);
+
+/**
+ * Flags a body for continuous collision detection.
+ * Each tick, a fast body is swept against the static bodies in its scene
+ * (infinite mass and at rest), so that it cannot pass straight through one
+ * between two ticks. See scene_tick().
+ * Bodies are not fast by default.
+ *
+ * @param body the pointer to the body
+ * @param fast whether the body should be swept against static bodies
+ */
+void body_set_fast(body_t *body, bool fast);
+
+/**
+ * Returns whether a body is flagged for continuous collision detection.
+ *
+ * @param body the pointer to the body
+ * @return whether body_set_fast() last flagged the body as fast
+ */
+bool body_is_fast(body_t *body);
+
+/**
+ * Flags a body as a sensor, or clears the flag.
+ * A sensor is not solid: fast bodies are not stopped by it and scene queries
+ * pass through it. It only reports when other bodies start and stop
+ * overlapping it, through handlers registered with
+ * scene_add_sensor_handler().
+ * Bodies are not sensors by default.
+ *
+ * @param body the pointer to the body
+ * @param sensor whether the body should be a sensor
+ */
+void body_set_sensor(body_t *body, bool sensor);
+
+/**
+ * Returns whether a body is a sensor.
+ *
+ * @param body the pointer to the body
+ * @return whether body_set_sensor() last flagged the body as a sensor
+ */
+bool body_is_sensor(body_t *body);
+
+/**
+ * Sets the collision categories a body belongs to, as a set of bits.
+ * The scene calls the handlers registered for a pair of categories
+ * (see scene_add_collision_handler()) when bodies in them touch.
+ * Bodies belong to no categories by default.
+ *
+ * @param body the pointer to the body
+ * @param category the bits of the categories the body belongs to
+ */
+void body_set_category(body_t *body, uint32_t category);
+
+/**
+ * Gets the collision categories a body belongs to.
+ *
+ * @param body the pointer to the body
+ * @return the bits set by body_set_category()
+ */
+uint32_t body_get_category(body_t *body);
+
+/**
+ * Sets the collision categories a body can touch, as a set of bits.
+ * Two bodies only touch if each one's categories overlap the other's mask.
+ * Bodies can touch every category by default.
+ *
+ * @param body the pointer to the body
+ * @param mask the bits of the categories the body can touch
+ */
+void body_set_mask(body_t *body, uint32_t mask);
+
+/**
+ * Gets the collision categories a body can touch.
+ *
+ * @param body the pointer to the body
+ * @return the bits set by body_set_mask()
+ */
+uint32_t body_get_mask(body_t *body);
+
+/**
+ * Gets the kind with a name, creating it the first time the name is seen.
+ * Kinds are numbered from 1 in the order their names are first interned,
+ * so they can index arrays (see body_kind_count()).
+ *
+ * @param name the kind's name; copied, so it need not outlive the call
+ * @return the same kind for every call with an equal name
+ */
+body_kind_t body_kind_intern(const char *name);
+
+/**
+ * Gets the name a kind was interned with.
+ *
+ * @param kind a kind returned by body_kind_intern(), or BODY_KIND_NONE
+ * @return the kind's name, or NULL for BODY_KIND_NONE
+ */
+const char *body_kind_name(body_kind_t kind);
+
+/**
+ * Gets the number of kinds, including BODY_KIND_NONE.
+ *
+ * @return one more than the largest kind interned so far
+ */
+size_t body_kind_count(void);
+
+/**
+ * Releases the names of all interned kinds, so the next kind interned is
+ * kind 1 again.
+ * Call it once no body or scene uses a kind any more, e.g. when the game
+ * exits.
+ */
+void body_kinds_free(void);
+
+/**
+ * Releases the arrays that hold every body's state, so the next body created
+ * starts them afresh.
+ * Asserts that every body has been freed, e.g. with scene_free().
+ * Handles to bodies freed before this may match bodies created after it.
+ * Call it when the game exits, along with body_kinds_free().
+ */
+void body_store_free(void);
+
+/**
+ * Sets what kind of body a body is.
+ * Scenes index their bodies by kind when they are added (see
+ * scene_get_kind_body()), so the kind must be set before the body is added to
+ * a scene.
+ *
+ * @param body the pointer to the body
+ * @param kind a kind returned by body_kind_intern(), or BODY_KIND_NONE
+ */
+void body_set_kind(body_t *body, body_kind_t kind);
+
+/**
+ * Gets what kind of body a body is.
+ *
+ * @param body the pointer to the body
+ * @return the kind set by body_set_kind(), or BODY_KIND_NONE if it was never
+ * set
+ */
+body_kind_t body_get_kind(body_t *body);
+
+/**
+ * Gets a handle to a body, e.g. to keep in a long-lived structure.
+ *
+ * @param body the pointer to the body
+ * @return a handle that refers to the body until it is freed
+ */
+body_handle_t body_get_handle(body_t *body);
+
+/**
+ * Finds the body a handle refers to.
+ * Takes constant time.
+ *
+ * @param handle a handle returned from body_get_handle()
+ * @return the body, or NULL if it has been freed or the handle refers to
+ * no body
+ */
+body_t *body_from_handle(body_handle_t handle);
+
 /**
  * Frees memory allocated for a body.
+ * Handles to it no longer refer to any body.
  *
  * @param body the pointer to the body
  */
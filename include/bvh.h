@@ -0,0 +1,110 @@
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include "body.h"
+#include "list.h"
+#include "vector.h"
+
+/**
+ * A bounding volume hierarchy: a binary tree of axis-aligned boxes over a set
+ * of bodies, used to skip bodies that a query cannot reach.
+ */
+typedef struct bvh bvh_t;
+
+/**
+ * A function called for each body a sweep may reach, nearest boxes first.
+ *
+ * @param body a body whose bounding box the sweep reaches
+ * @param aux the auxiliary value passed to bvh_sweep()
+ * @return the fraction of the sweep that still needs to be searched,
+ * e.g. the time of the nearest hit found so far, or 1 to keep searching
+ */
+typedef double (*bvh_sweep_callback_t)(body_t *body, void *aux);
+
+/**
+ * A function called for each body whose bounding box overlaps a query box.
+ *
+ * @param index the position of the body in the list the hierarchy was built
+ * from
+ * @param aux the auxiliary value passed to bvh_query()
+ */
+typedef void (*bvh_query_callback_t)(size_t index, void *aux);
+
+/**
+ * Gets the bounding box of a body's current shape.
+ * Equivalent to body_get_bounding_box().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the smallest axis-aligned box containing the body
+ */
+aabb_t aabb_from_body(body_t *body);
+
+/**
+ * Merges boxes whose union is also a box, such as two boxes of the same height
+ * side by side, or a box inside another, until no more can be merged.
+ * The merged boxes cover exactly the same area as the originals.
+ *
+ * @param boxes the boxes to merge; the first entries are replaced by the
+ * merged boxes, in no particular order
+ * @param count the number of boxes
+ * @return the number of merged boxes
+ */
+size_t aabb_merge(aabb_t *boxes, size_t count);
+
+/**
+ * Builds a bounding volume hierarchy over the current positions of some
+ * bodies. The hierarchy does not own the bodies and does not notice when they
+ * move, so it must be rebuilt after they do.
+ * Asserts that the required memory is successfully allocated.
+ *
+ * @param bodies the bodies to build the hierarchy over
+ * @return a pointer to the new hierarchy
+ */
+bvh_t *bvh_init(list_t *bodies);
+
+/**
+ * Finds the bodies that a box moving in a straight line may touch,
+ * visiting the closest ones first.
+ * A box of zero size sweeps a ray.
+ *
+ * @param bvh a pointer to a hierarchy returned from bvh_init()
+ * @param box the box at the start of the sweep
+ * @param displacement the distance and direction the box travels
+ * @param callback the function to call for each body the box may touch.
+ * Bodies whose boxes are only reached past the fraction it returns are
+ * skipped.
+ * @param aux an auxiliary value to pass to callback
+ */
+void bvh_sweep(bvh_t *bvh, aabb_t box, vector_t displacement,
+               bvh_sweep_callback_t callback, void *aux);
+
+/**
+ * Finds the bodies whose bounding boxes overlap or touch a box.
+ *
+ * @param bvh a pointer to a hierarchy returned from bvh_init()
+ * @param box the box to search
+ * @param callback the function to call for each body found
+ * @param aux an auxiliary value to pass to callback
+ */
+void bvh_query(bvh_t *bvh, aabb_t box, bvh_query_callback_t callback,
+               void *aux);
+
+/**
+ * Gets the bounding box a body had when the hierarchy was built.
+ * Asserts that the index is valid.
+ *
+ * @param bvh a pointer to a hierarchy returned from bvh_init()
+ * @param index the position of the body in the list the hierarchy was built
+ * from
+ * @return the body's bounding box
+ */
+aabb_t bvh_get_box(bvh_t *bvh, size_t index);
+
+/**
+ * Releases memory allocated for a hierarchy, but not the bodies in it.
+ *
+ * @param bvh a pointer to a hierarchy returned from bvh_init()
+ */
+void bvh_free(bvh_t *bvh);
+
+#endif // #ifndef __BVH_H__
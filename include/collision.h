@@ -5,19 +5,41 @@
 #include "list.h"
 #include "vector.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
+/**
+ * The faces of a body that another body is touching, as seen from the other
+ * body: UP_COLLISION means it is resting on top of the body,
+ * RIGHT_COLLISION means it is pressed against the body's right side, etc.
+ * The values are bit flags, so contacts with several bodies are combined
+ * with | and tested with &.
+ */
 typedef enum {
   NO_COLLISION = 0,
-  RIGHT_COLLISION = 1,
-  LEFT_COLLISION = 2,
-  UP_COLLISION = 3,
-  UP_RIGHT_COLLISION = 4,
-  UP_LEFT_COLLISION = 5,
-  DOWN_COLLISION = 6,
-  DOWN_RIGHT_COLLISION = 7,
-  DOWN_LEFT_COLLISION = 8
+  RIGHT_COLLISION = 1 << 0,
+  LEFT_COLLISION = 1 << 1,
+  UP_COLLISION = 1 << 2,
+  DOWN_COLLISION = 1 << 3,
+  UP_RIGHT_COLLISION = UP_COLLISION | RIGHT_COLLISION,
+  UP_LEFT_COLLISION = UP_COLLISION | LEFT_COLLISION,
+  DOWN_RIGHT_COLLISION = DOWN_COLLISION | RIGHT_COLLISION,
+  DOWN_LEFT_COLLISION = DOWN_COLLISION | LEFT_COLLISION
 } collision_type_t;
 
+/**
+ * The maximum number of contact points in a contact manifold.
+ */
+#define MAX_CONTACT_POINTS 2
+
+/**
+ * How far apart two shapes can be and still count as colliding.
+ * Shapes that touch exactly when the simulation stores doubles can end up a
+ * small fraction of a pixel apart when it stores floats (see SIM_FLOAT32 in
+ * vector.h), so touching is decided to within this distance.
+ */
+extern const double TOUCH_DISTANCE;
+
 /**
  * Represents the status of a collision between two shapes.
  * The shapes are either not colliding, or they are colliding along some axis.
@@ -34,8 +56,65 @@ typedef struct {
   vector_t axis;
 } collision_info_t;
 
+/**
+ * Describes how two colliding shapes touch.
+ */
+typedef struct {
+  /**
+   * The axis of least penetration.
+   * This is a unit vector pointing from the first shape towards the second.
+   */
+  vector_t normal;
+  /** How far the shapes overlap along the normal */
+  double depth;
+  /** The points where the shapes touch */
+  vector_t points[MAX_CONTACT_POINTS];
+  /** The number of entries of points that are set */
+  size_t num_points;
+  /** The face of the second shape that the first shape is touching */
+  collision_type_t face;
+} contact_manifold_t;
+
+/**
+ * A function called when a collision occurs.
+ * @param body1 the first body
+ * @param body2 the second body
+ * @param axis a unit vector pointing from body1 towards body2
+ *   that defines the direction the two bodies are colliding in
+ * @param aux the auxiliary value
+ * @param force_const the force constant
+ */
+typedef void (*collision_handler_t)(body_t *body1, body_t *body2, vector_t axis,
+                                    void *aux, double force_const);
+
+/**
+ * Represents the first contact between a moving body and a static one.
+ */
+typedef struct {
+  /** Whether the moving body touches the static body during its motion */
+  bool hit;
+  /**
+   * If hit is true, the fraction of the displacement (in [0, 1]) travelled
+   * before the bodies first touch.
+   */
+  double time;
+  /**
+   * If hit is true, the fraction of the displacement after which the bodies
+   * stop overlapping. This is at least 1 if they still overlap at the end of
+   * the motion, and less than 1 if the moving body passes straight through.
+   */
+  double exit_time;
+  /**
+   * If hit is true, the axis the bodies first touch along.
+   * This is a unit vector pointing from the moving body towards the static one.
+   */
+  vector_t axis;
+} impact_info_t;
+
 /**
  * Computes the status of the collision between two bodies.
+ * Bodies up to TOUCH_DISTANCE apart are colliding, with a penetration depth
+ * of at least -TOUCH_DISTANCE.
  *
  * @param body1 the first body
  * @param body2 the second body
@@ -44,4 +123,157 @@ typedef struct {
  */
 collision_info_t find_collision(body_t *body1, body_t *body2);
 
+/**
+ * Computes the status of the collision between two bodies,
+ * and if they collide, how they touch.
+ *
+ * @param body1 the first body
+ * @param body2 the second body
+ * @param manifold if non-NULL and the bodies collide, filled in with the
+ * normal, penetration depth, contact points and face of the collision
+ * @return the same as find_collision(body1, body2)
+ */
+collision_info_t find_collision_with_manifold(body_t *body1, body_t *body2,
+                                              contact_manifold_t *manifold);
+
+/**
+ * Determines whether two bodies overlap, without working out how.
+ * This is cheaper than find_collision() when only the answer is needed,
+ * since most pairs are rejected by their bounding boxes.
+ *
+ * @param body1 the first body
+ * @param body2 the second body
+ * @return whether the shapes are colliding
+ */
+bool find_overlap(body_t *body1, body_t *body2);
+
+/**
+ * Classifies a collision axis by the face of the second body it hits.
+ * For example, an axis pointing down means the first body is on top of the
+ * second body, so the result is UP_COLLISION.
+ *
+ * @param axis a unit vector pointing from the first body towards the second
+ * @return the face of the second body that the first body is touching
+ */
+collision_type_t collision_face(vector_t axis);
+
+/**
+ * Computes when a body moving along a straight line first touches a static
+ * body, using the separating axis theorem on the swept shapes.
+ * Bodies that already overlap at the start of the motion are not reported
+ * as a hit, since they are in contact rather than about to collide.
+ *
+ * @param mover the moving body, at its position before the motion
+ * @param displacement the distance and direction the mover travels
+ * @param obstacle the static body
+ * @return whether and when the bodies first touch, and along which axis
+ */
+impact_info_t find_time_of_impact(body_t *mover, vector_t displacement,
+                                  body_t *obstacle);
+
+/**
+ * Computes where a ray first enters a body.
+ * Rays that start inside the body do not hit it.
+ *
+ * @param origin the start of the ray
+ * @param displacement the direction and length of the ray
+ * @param obstacle the body the ray is cast against
+ * @return whether the ray enters the body, the fraction of its length at which
+ * it does, and the axis of the face it enters through, pointing into the body
+ */
+impact_info_t find_ray_impact(vector_t origin, vector_t displacement,
+                              body_t *obstacle);
+
+/**
+ * A batch of axis-aligned boxes stored in structure-of-arrays form.
+ * The boxes' edges are kept in separate arrays,
+ * so several boxes can be tested against one shape per SIMD instruction.
+ */
+typedef struct box_batch box_batch_t;
+
+/**
+ * The number of 64-bit words needed to hold a hit bitmask for n boxes.
+ */
+#define BOX_BATCH_MASK_WORDS(n) (((n) + 63) / 64)
+
+/**
+ * Allocates memory for an empty box batch.
+ * Asserts that the required memory is allocated.
+ *
+ * @param initial_capacity the number of boxes to allocate space for
+ * @return a pointer to the newly allocated batch
+ */
+box_batch_t *box_batch_init(size_t initial_capacity);
+
+/**
+ * Returns whether a body is an axis-aligned box, so that testing it as part
+ * of a box batch finds the same overlap as find_collision() would
+ * (up to rounding when the simulation stores floats).
+ *
+ * @param body the body to check
+ * @return whether the body's edges all run along the x or y axis
+ */
+bool box_batch_fits(body_t *body);
+
+/**
+ * Appends the axis-aligned bounding box of a body's vertices to a batch.
+ * The batch does not own the body.
+ *
+ * @param batch a pointer to a batch returned from box_batch_init()
+ * @param body the body whose bounding box to add
+ */
+void box_batch_add(box_batch_t *batch, body_t *body);
+
+/**
+ * Removes every box from a batch, keeping its allocated capacity.
+ *
+ * @param batch a pointer to a batch returned from box_batch_init()
+ */
+void box_batch_clear(box_batch_t *batch);
+
+/**
+ * Gets the number of boxes in a batch.
+ *
+ * @param batch a pointer to a batch returned from box_batch_init()
+ * @return the number of boxes added since the batch was last cleared
+ */
+size_t box_batch_size(box_batch_t *batch);
+
+/**
+ * Gets the body whose box is at a given index in a batch.
+ * Asserts that the index is valid.
+ *
+ * @param batch a pointer to a batch returned from box_batch_init()
+ * @param index the index of the box (in the order they were added)
+ * @return the body the box was created from
+ */
+body_t *box_batch_get_body(box_batch_t *batch, size_t index);
+
+/**
+ * Releases the memory allocated for a box batch.
+ *
+ * @param batch a pointer to a batch returned from box_batch_init()
+ */
+void box_batch_free(box_batch_t *batch);
+
+/**
+ * Tests one convex body against every box in a batch with the separating
+ * axis theorem, several boxes per SIMD instruction (AVX or SSE natively,
+ * wasm128 under emcc, scalar otherwise).
+ *
+ * Bit i of the hit mask is set if the body overlaps or touches box i, as
+ * find_collision() would report for a body that box_batch_fits().
+ * For every hit, axes[i] is set to the axis of least penetration,
+ * a unit vector pointing from the body towards the box.
+ * Entries of axes for boxes that were not hit are left untouched.
+ *
+ * @param body the convex body to test
+ * @param batch the boxes to test the body against
+ * @param hits an array of BOX_BATCH_MASK_WORDS(box_batch_size(batch)) words
+ * @param axes an array of box_batch_size(batch) vectors
+ * @return the number of boxes the body overlaps
+ */
+size_t find_collision_batch(body_t *body, box_batch_t *batch, uint64_t *hits,
+                            vector_t *axes);
+
 #endif // #ifndef __COLLISION_H__
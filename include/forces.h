@@ -4,18 +4,6 @@
 #include "collision.h"
 #include "scene.h"
 
-/**
- * A function called when a collision occurs.
- * @param body1 the first body
- * @param body2 the second body
- * @param axis a unit vector pointing from body1 towards body2
- *   that defines the direction the two bodies are colliding in
- * @param aux the auxiliary value
- * @param force_const the force constant
- */
-typedef void (*collision_handler_t)(body_t *body1, body_t *body2, vector_t axis,
-                                    void *aux, double force_const);
-
 /**
  * Adds a force creator to a scene that applies gravity between two bodies.
  * The force creator will be called each tick
@@ -2,7 +2,9 @@
 #define __SCENE_H__
 
 #include "body.h"
+#include "collision.h"
 #include "list.h"
+#include <stdint.h>
 
 /**
  * A collection of bodies and force creators.
@@ -19,6 +21,71 @@ typedef struct scene scene_t;
  */
 typedef void (*force_creator_t)(void *aux, list_t *bodies);
 
+/**
+ * The ways a body's overlap with a sensor can change during a tick.
+ */
+typedef enum {
+  /** The body started overlapping the sensor */
+  SENSOR_ENTER,
+  /** The body was already overlapping the sensor and still is */
+  SENSOR_STAY,
+  /** The body stopped overlapping the sensor, or one of them was removed */
+  SENSOR_EXIT
+} sensor_event_t;
+
+/**
+ * The bit for one sensor event in a mask of the events a sensor handler is
+ * called for (see scene_add_sensor_handler()).
+ */
+#define SENSOR_EVENT_BIT(event) ((uint32_t)1 << (event))
+
+/**
+ * The events a sensor handler that only cares when the overlap starts or stops
+ * is called for.
+ */
+#define SENSOR_EDGE_EVENTS                                                     \
+  (SENSOR_EVENT_BIT(SENSOR_ENTER) | SENSOR_EVENT_BIT(SENSOR_EXIT))
+
+/**
+ * Every event a sensor handler can be called for.
+ */
+#define SENSOR_ALL_EVENTS                                                      \
+  (SENSOR_EDGE_EVENTS | SENSOR_EVENT_BIT(SENSOR_STAY))
+
+/**
+ * A function called when a body's overlap with a sensor changes.
+ * @param sensor the sensor body
+ * @param body the body overlapping the sensor
+ * @param event how the overlap changed
+ * @param aux an auxiliary value that can store parameters or state
+ */
+typedef void (*sensor_handler_t)(body_t *sensor, body_t *body,
+                                 sensor_event_t event, void *aux);
+
+/**
+ * A function which decides whether a scene query should consider a body.
+ * @param body a body in the scene
+ * @return whether the query may hit the body
+ */
+typedef bool (*body_filter_t)(body_t *body);
+
+/**
+ * The result of a raycast or shape cast against a scene.
+ */
+typedef struct {
+  /** Whether anything was hit */
+  bool hit;
+  /** If hit is true, the closest body hit */
+  body_t *body;
+  /** If hit is true, how far the ray or shape travelled before the hit */
+  double distance;
+  /**
+   * If hit is true, the unit normal of the surface hit,
+   * pointing back towards the ray or shape.
+   */
+  vector_t normal;
+} scene_hit_t;
+
 /**
  * Allocates memory for an empty scene.
  * Makes a reasonable guess of the number of bodies to allocate space for.
@@ -28,6 +95,39 @@ typedef void (*force_creator_t)(void *aux, list_t *bodies);
  */
 scene_t *scene_init(void);
 
+/**
+ * Sets how many threads a scene uses to check which bodies touch, run threaded
+ * force creators (see scene_add_threaded_force_creator()) and tick bodies,
+ * including the thread calling scene_tick().
+ * Handlers and other force creators are always called on the thread calling
+ * scene_tick(), while no other thread is working on the scene, in the same
+ * order whatever the number of threads. The bodies end up in the same state
+ * whatever the number of threads.
+ * Scenes use one thread per processor by default.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param num_workers the number of threads, or 0 for one per processor
+ */
+void scene_set_workers(scene_t *scene, size_t num_workers);
+
+/**
+ * Lets a scene put dynamic bodies to sleep once they have settled.
+ * Bodies that touch, or that are pushed by the same force creator, form an
+ * island. Once every body in an island has moved slower than a given speed
+ * for a given time, they all fall asleep: scene_tick() stops moving them,
+ * checking what they touch and running force creators that only act on
+ * sleeping or static bodies. The whole island wakes when any of its bodies
+ * is touched by an awake body that can push it, is pushed by a force creator,
+ * or is moved by the program (see body_set_sleeping()).
+ * Scenes never put bodies to sleep by default.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param speed the speed below which a body is resting, or 0 to keep every
+ * body awake
+ * @param time how long an island must rest before it falls asleep, in seconds
+ */
+void scene_set_sleeping(scene_t *scene, double speed, double time);
+
 /**
  * Gets the number of bodies in a given scene.
  *
@@ -46,6 +146,29 @@ size_t scene_bodies(scene_t *scene);
  */
 body_t *scene_get_body(scene_t *scene, size_t index);
 
+/**
+ * Gets the number of bodies of a given kind in a scene.
+ * Scenes keep a list of each kind's bodies, so finding them does not require
+ * checking every body.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param kind the kind to count (see body_set_kind())
+ * @return the number of bodies of the kind added with scene_add_body()
+ */
+size_t scene_kind_bodies(scene_t *scene, body_kind_t kind);
+
+/**
+ * Gets one of the bodies of a given kind in a scene.
+ * A kind's bodies are kept in the order they were added to the scene.
+ * Asserts that the index is valid.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param kind the kind of the body (see body_set_kind())
+ * @param index the index of the body among the kind's bodies (starting at 0)
+ * @return a pointer to the body at the given index
+ */
+body_t *scene_get_kind_body(scene_t *scene, body_kind_t kind, size_t index);
+
 /**
  * Adds a body to a scene, taking ownership of the body.
  *
@@ -71,6 +194,8 @@ void scene_remove_body(scene_t *scene, size_t index);
  * The auxiliary value is passed to the force creator each time it is called.
  * The force creator is registered with a list of bodies it applies to,
  * so it can be removed when any one of the bodies is removed.
+ * The force creator is always called on the thread calling scene_tick(), so
+ * it may call handlers or change anything else the game owns.
  *
  * @param scene a pointer to a scene returned from scene_init()
  * @param force_creator a force creator function
@@ -84,18 +209,157 @@ void scene_remove_body(scene_t *scene, size_t index);
 void scene_add_force_creator(scene_t *scene, force_creator_t force_creator,
                              void *aux, list_t *bodies, free_func_t freer);
 
+/**
+ * Adds a force creator to a scene, like scene_add_force_creator(), that may
+ * run on any of the scene's threads (see scene_set_workers()).
+ * Threaded force creators that share no bodies with each other or with other
+ * force creators, even through further force creators, may run at the same
+ * time. So a threaded force creator must only change the bodies in its list,
+ * its auxiliary value must not be changed by other force creators, and it
+ * must not call handlers or change anything else.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param force_creator a force creator function
+ * @param aux an auxiliary value to pass to `force_creator` when it is called
+ * @param bodies the list of bodies affected by the force creator, owned by the
+ * scene as in scene_add_force_creator()
+ * @param freer the function to free the aux object if it is not NULL
+ */
+void scene_add_threaded_force_creator(scene_t *scene,
+                                      force_creator_t force_creator, void *aux,
+                                      list_t *bodies, free_func_t freer);
+
+/**
+ * The number of collision categories: one for each bit of a category mask.
+ */
+#define MAX_CATEGORIES 32
+
+/**
+ * Registers a handler to be called whenever a body in one collision category
+ * starts touching a body in another (see body_set_category()).
+ * Every tick, after the force creators run, the scene finds the touching pairs
+ * in a single pass over its bodies and calls the handlers registered for each
+ * pair's categories, in order of the bodies' indices in the scene.
+ * Like create_collision(), the handler is called once when the bodies start
+ * touching, not again until they have separated.
+ * Pairs where either body is a sensor are only reported to sensor handlers.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param category1 the category of the first body passed to the handler;
+ * exactly one bit must be set
+ * @param category2 the category of the second body passed to the handler;
+ * exactly one bit must be set
+ * @param handler the function to call, with the axis pointing from the body in
+ * category1 towards the body in category2
+ * @param aux an auxiliary value to pass to the handler
+ * @param force_const a constant to pass to the handler
+ * @param freer the function to free the aux object if it is not NULL
+ */
+void scene_add_collision_handler(scene_t *scene, uint32_t category1,
+                                 uint32_t category2,
+                                 collision_handler_t handler, void *aux,
+                                 double force_const, free_func_t freer);
+
+/**
+ * Registers a handler to be told when a body in one collision category
+ * overlaps a sensor in another (see body_set_sensor()).
+ * Pairs are found as for scene_add_collision_handler(). The handler is called
+ * with SENSOR_ENTER when they start to overlap, SENSOR_STAY on each later
+ * tick that they still do, and SENSOR_EXIT once when they stop or either body
+ * is removed, but only for the events in its mask. Pairs that stay
+ * overlapping cost nothing to dispatch unless some handler asks for
+ * SENSOR_STAY.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param sensor_category the category of the sensors;
+ * exactly one bit must be set
+ * @param body_category the category of the bodies to watch for;
+ * exactly one bit must be set
+ * @param handler the function to call when the overlap changes
+ * @param events the events to call the handler for, as SENSOR_EVENT_BIT()s,
+ * e.g. SENSOR_EVENT_BIT(SENSOR_ENTER), SENSOR_EDGE_EVENTS or
+ * SENSOR_ALL_EVENTS
+ * @param aux an auxiliary value to pass to the handler
+ * @param freer the function to free the aux object if it is not NULL
+ */
+void scene_add_sensor_handler(scene_t *scene, uint32_t sensor_category,
+                              uint32_t body_category, sensor_handler_t handler,
+                              uint32_t events, void *aux, free_func_t freer);
+
 /**
  * Executes a tick of a given scene over a small time interval.
- * This requires executing all the force creators
+ * This requires executing all the force creators,
+ * calling the handlers of touching bodies
+ * (see scene_add_collision_handler()),
  * and then ticking each body (see body_tick()).
+ * A body flagged as fast (see body_set_fast()) that would pass straight
+ * through a static body during the tick is stopped where it first touches it.
  * If any bodies are marked for removal, they are removed from the scene
- * and freed, along with any force creators acting on them.
+ * and freed, along with any force creators acting on them; see
+ * scene_get_removed().
  *
  * @param scene a pointer to a scene returned from scene_init()
  * @param dt the time elapsed since the last tick, in seconds
  */
 void scene_tick(scene_t *scene, double dt);
 
+/**
+ * Gets the handles of the bodies the last scene_tick() removed and freed,
+ * e.g. to pass to asset_flush_removed().
+ * Takes constant time.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param count set to the number of bodies removed
+ * @return the handles, in the order the bodies were in the scene,
+ * valid until the next scene_tick() or scene_free()
+ */
+const body_handle_t *scene_get_removed(scene_t *scene, size_t *count);
+
+/**
+ * Saves the pose of every body in a scene (see body_save_pose()).
+ * Calling this before a frame's last tick lets the frame be drawn part of the
+ * way through that tick.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ */
+void scene_save_poses(scene_t *scene);
+
+/**
+ * Finds the first body a ray hits.
+ * Bodies the ray starts inside and sensors are not hit.
+ * Queries see bodies where they were after the last call to scene_tick()
+ * or scene_add_body(), and skip bodies marked for removal.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param origin the start of the ray
+ * @param dir the direction of the ray; it does not need to be a unit vector
+ * @param max_dist how far along the ray to search
+ * @param filter a function that returns whether a body can be hit,
+ * or NULL to consider every body
+ * @return the closest body hit, if any, and where
+ */
+scene_hit_t scene_raycast(scene_t *scene, vector_t origin, vector_t dir,
+                          double max_dist, body_filter_t filter);
+
+/**
+ * Finds the first body a convex body would hit if it moved in a straight
+ * line. Bodies it already overlaps are hit at distance 0 if the motion is
+ * within 45 degrees of the direction they overlap along, and ignored
+ * otherwise. The moving body itself and sensors are never hit.
+ * Queries see bodies as described for scene_raycast().
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param shape the body to move, at its starting position.
+ * It does not need to be in the scene, and is not moved.
+ * @param dir the direction to move; it does not need to be a unit vector
+ * @param max_dist how far to move
+ * @param filter a function that returns whether a body can be hit,
+ * or NULL to consider every body
+ * @return the closest body hit, if any, and where
+ */
+scene_hit_t scene_shape_cast(scene_t *scene, body_t *shape, vector_t dir,
+                             double max_dist, body_filter_t filter);
+
 /**
  * Releases memory allocated for a given scene
  * and all the bodies and force creators it contains.
@@ -72,15 +72,38 @@ bool sdl_is_done(state_t *state);
  */
 void sdl_clear(void);
 
+/**
+ * Sets how far between their previous and current poses bodies are drawn
+ * (see body_save_pose()), so that a frame shown partway through a tick
+ * still moves smoothly. Affects sdl_draw_body() and
+ * sdl_get_body_bounding_box(). Initially 1, i.e. bodies are drawn where they
+ * are.
+ *
+ * @param alpha how far to go, from 0 (the previous pose) to 1 (the current
+ * one)
+ */
+void sdl_set_interpolation(double alpha);
+
 /**
  * Returns the SDL_Rect bounding box when given a body.
+ * The box moves with the body's interpolated centroid
+ * (see sdl_set_interpolation()), but does not rotate with it.
  *
  * @param body body_t where the bounding box will be determined by
  */
 SDL_Rect sdl_get_body_bounding_box(body_t *body);
 
 /**
- * Draws a body using the color of the body.
+ * Returns the SDL_Rect covering an axis-aligned box in scene coordinates.
+ *
+ * @param min the corner of the box with the smallest coordinates
+ * @param max the corner of the box with the largest coordinates
+ */
+SDL_Rect sdl_get_bounding_box(vector_t min, vector_t max);
+
+/**
+ * Draws a body using the color of the body,
+ * at its interpolated pose (see sdl_set_interpolation()).
  *
  * @param body the body struct to draw
  */
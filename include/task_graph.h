@@ -0,0 +1,68 @@
+#ifndef __TASK_GRAPH_H__
+#define __TASK_GRAPH_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A list of systems that run together, e.g. the work of one frame.
+ * Each system declares which resources (bits of a uint32_t, chosen by the
+ * caller) it reads and writes. Two systems conflict if either one writes a
+ * resource the other reads or writes; conflicting systems always run in the
+ * order they were added, while systems that do not conflict may run at the
+ * same time on different threads.
+ * So running a graph gives the same result as running its systems in order,
+ * as long as each system only uses the resources it declares.
+ */
+typedef struct task_graph task_graph_t;
+
+/**
+ * A function run each time a graph is run.
+ *
+ * @param aux the auxiliary value passed to task_graph_add()
+ */
+typedef void (*task_system_t)(void *aux);
+
+/**
+ * Allocates memory for an empty graph, with a pool of threads to run its
+ * systems on.
+ * Asserts that the required memory is successfully allocated.
+ *
+ * @param num_workers the number of threads, including the thread that runs
+ * the graph, or 0 for one per processor
+ * @return a pointer to the new graph
+ */
+task_graph_t *task_graph_init(size_t num_workers);
+
+/**
+ * Adds a system to the end of a graph.
+ *
+ * @param graph a pointer to a graph returned from task_graph_init()
+ * @param system the function to run
+ * @param aux an auxiliary value to pass to system, which the graph does not
+ * own
+ * @param reads the bits of the resources the system reads
+ * @param writes the bits of the resources the system changes
+ * @param main_thread whether the system must run on the thread that runs the
+ * graph, e.g. because it draws
+ */
+void task_graph_add(task_graph_t *graph, task_system_t system, void *aux,
+                    uint32_t reads, uint32_t writes, bool main_thread);
+
+/**
+ * Runs every system in a graph once, and waits for all of them to finish.
+ * Must only be called from the thread that created the graph.
+ *
+ * @param graph a pointer to a graph returned from task_graph_init()
+ */
+void task_graph_run(task_graph_t *graph);
+
+/**
+ * Stops a graph's threads and releases its memory.
+ *
+ * @param graph a pointer to a graph returned from task_graph_init()
+ */
+void task_graph_free(task_graph_t *graph);
+
+#endif // #ifndef __TASK_GRAPH_H__
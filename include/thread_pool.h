@@ -0,0 +1,97 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <stddef.h>
+
+/**
+ * A fixed set of worker threads that run the iterations of a loop in
+ * parallel. The thread that starts a loop works on it too.
+ * Each worker starts on its own share of consecutive iterations, and workers
+ * that finish their share early steal what is left of the others'.
+ * If threads cannot be created (e.g. in a WebAssembly build without
+ * thread support), loops simply run on the calling thread.
+ */
+typedef struct thread_pool thread_pool_t;
+
+/**
+ * A function run for each iteration of a parallel loop.
+ * Iterations may run in any order and at the same time as each other.
+ *
+ * @param index the iteration to run
+ * @param worker which worker is running it, from 0 (the calling thread) up to
+ * thread_pool_workers() - 1, so it can write to a per-worker buffer
+ * @param aux the auxiliary value passed to thread_pool_for()
+ */
+typedef void (*thread_pool_task_t)(size_t index, size_t worker, void *aux);
+
+/**
+ * A function run once on the thread that starts a loop
+ * (see thread_pool_for_with_job()).
+ *
+ * @param aux the auxiliary value passed with the job
+ */
+typedef void (*thread_pool_job_t)(void *aux);
+
+/**
+ * Starts a pool of worker threads.
+ * Asserts that the required memory is successfully allocated.
+ *
+ * @param num_workers the number of workers, including the calling thread,
+ * or 0 to use one per processor
+ * @return a pointer to the new pool
+ */
+thread_pool_t *thread_pool_init(size_t num_workers);
+
+/**
+ * Gets the number of workers that run a pool's loops,
+ * including the calling thread.
+ * This may be fewer than requested if threads could not be created.
+ *
+ * @param pool a pointer to a pool returned from thread_pool_init()
+ * @return the number of workers
+ */
+size_t thread_pool_workers(thread_pool_t *pool);
+
+/**
+ * Runs a task for every index from 0 to count - 1, spread across the pool's
+ * workers, and waits for all of them to finish.
+ * Must only be called from the thread that created the pool.
+ *
+ * @param pool a pointer to a pool returned from thread_pool_init()
+ * @param count the number of iterations
+ * @param chunk how many consecutive iterations a worker claims (or steals) at
+ * a time
+ * @param task the function to run for each iteration
+ * @param aux an auxiliary value to pass to task
+ */
+void thread_pool_for(thread_pool_t *pool, size_t count, size_t chunk,
+                     thread_pool_task_t task, void *aux);
+
+/**
+ * Acts like thread_pool_for(), but the calling thread first runs a job of its
+ * own while the other workers start on the loop, then helps with what is
+ * left of the loop. Useful for work that must stay on the calling thread,
+ * such as drawing.
+ * If the pool has no threads of its own, the job runs before the loop.
+ *
+ * @param pool a pointer to a pool returned from thread_pool_init()
+ * @param count the number of iterations
+ * @param chunk how many consecutive iterations a worker claims (or steals) at
+ * a time
+ * @param task the function to run for each iteration
+ * @param aux an auxiliary value to pass to task
+ * @param job the function to run on the calling thread
+ * @param job_aux an auxiliary value to pass to job
+ */
+void thread_pool_for_with_job(thread_pool_t *pool, size_t count, size_t chunk,
+                              thread_pool_task_t task, void *aux,
+                              thread_pool_job_t job, void *job_aux);
+
+/**
+ * Stops a pool's threads and releases its memory.
+ *
+ * @param pool a pointer to a pool returned from thread_pool_init()
+ */
+void thread_pool_free(thread_pool_t *pool);
+
+#endif // #ifndef __THREAD_POOL_H__
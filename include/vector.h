@@ -1,6 +1,8 @@
 #ifndef __VECTOR_H__
 #define __VECTOR_H__
 
+#include <math.h>
+
 /**
  * A real-valued 2-dimensional vector.
  * Positive x is towards the right; positive y is towards the top.
@@ -18,6 +20,28 @@ typedef struct {
  */
 extern const vector_t VEC_ZERO;
 
+/**
+ * The types the simulation stores its state in, e.g. the positions,
+ * velocities and vertices of bodies.
+ * They match double and vector_t, unless the program is built with
+ * -DSIM_FLOAT32 (see the Makefile), which stores them as floats instead to
+ * halve their size; calculations still use vector_t.
+ * Convert between them with vec_from_sim() and vec_to_sim().
+ */
+#ifdef SIM_FLOAT32
+typedef float sim_real_t;
+typedef struct {
+  float x;
+  float y;
+} sim_vector_t;
+#else
+typedef double sim_real_t;
+typedef vector_t sim_vector_t;
+#endif
+
+// The operations below are defined here, rather than in vector.c, so that
+// the compiler can inline them into the loops that use them.
+
 /**
  * Adds two vectors.
  * Performs the usual componentwise vector sum.
@@ -26,7 +50,9 @@ extern const vector_t VEC_ZERO;
  * @param v2 the second vector
  * @return v1 + v2
  */
-vector_t vec_add(vector_t v1, vector_t v2);
+static inline vector_t vec_add(vector_t v1, vector_t v2) {
+  return (vector_t){.x = v1.x + v2.x, .y = v1.y + v2.y};
+}
 
 /**
  * Subtracts two vectors.
@@ -36,7 +62,9 @@ vector_t vec_add(vector_t v1, vector_t v2);
  * @param v2 the second vector
  * @return v1 - v2
  */
-vector_t vec_subtract(vector_t v1, vector_t v2);
+static inline vector_t vec_subtract(vector_t v1, vector_t v2) {
+  return (vector_t){.x = v1.x - v2.x, .y = v1.y - v2.y};
+}
 
 /**
  * Computes the additive inverse a vector.
@@ -45,7 +73,9 @@ vector_t vec_subtract(vector_t v1, vector_t v2);
  * @param v the vector whose inverse to compute
  * @return -v
  */
-vector_t vec_negate(vector_t v);
+static inline vector_t vec_negate(vector_t v) {
+  return (vector_t){.x = -v.x, .y = -v.y};
+}
 
 /**
  * Multiplies a vector by a scalar.
@@ -55,7 +85,9 @@ vector_t vec_negate(vector_t v);
  * @param v the vector to scale
  * @return scalar * v
  */
-vector_t vec_multiply(double scalar, vector_t v);
+static inline vector_t vec_multiply(double scalar, vector_t v) {
+  return (vector_t){.x = scalar * v.x, .y = scalar * v.y};
+}
 
 /**
  * Computes the dot product of two vectors.
@@ -65,7 +97,9 @@ vector_t vec_multiply(double scalar, vector_t v);
  * @param v2 the second vector
  * @return v1 . v2
  */
-double vec_dot(vector_t v1, vector_t v2);
+static inline double vec_dot(vector_t v1, vector_t v2) {
+  return v1.x * v2.x + v1.y * v2.y;
+}
 
 /**
  * Computes the cross product of two vectors,
@@ -76,7 +110,9 @@ double vec_dot(vector_t v1, vector_t v2);
  * @param v2 the second vector
  * @return the z-component of v1 x v2
  */
-double vec_cross(vector_t v1, vector_t v2);
+static inline double vec_cross(vector_t v1, vector_t v2) {
+  return v1.x * v2.y - v1.y * v2.x;
+}
 
 /**
  * Rotates a vector by an angle around (0, 0).
@@ -90,7 +126,11 @@ double vec_cross(vector_t v1, vector_t v2);
  * @param angle the angle to rotate the vector
  * @return v rotated by the given angle
  */
-vector_t vec_rotate(vector_t v, double angle);
+static inline vector_t vec_rotate(vector_t v, double angle) {
+  double c = cos(angle);
+  double s = sin(angle);
+  return (vector_t){.x = v.x * c - v.y * s, .y = v.x * s + v.y * c};
+}
 
 /**
  * Calculate the length of a vector.
@@ -98,6 +138,29 @@ vector_t vec_rotate(vector_t v, double angle);
  * @param v the vector to calculate the length of
  * @return a double representing the vector's magnitude
  */
-double vec_get_length(vector_t v);
+static inline double vec_get_length(vector_t v) {
+  return sqrt(v.x * v.x + v.y * v.y);
+}
+
+/**
+ * Converts a vector stored by the simulation to one to calculate with.
+ *
+ * @param v the stored vector
+ * @return v as a vector_t
+ */
+static inline vector_t vec_from_sim(sim_vector_t v) {
+  return (vector_t){.x = v.x, .y = v.y};
+}
+
+/**
+ * Converts a vector to the type the simulation stores it as,
+ * rounding it if the simulation stores floats.
+ *
+ * @param v the vector to store
+ * @return v as a sim_vector_t
+ */
+static inline sim_vector_t vec_to_sim(vector_t v) {
+  return (sim_vector_t){.x = (sim_real_t)v.x, .y = (sim_real_t)v.y};
+}
 
 #endif // #ifndef __VECTOR_H__
@@ -0,0 +1,100 @@
+#ifndef __VECTOR_BATCH_H__
+#define __VECTOR_BATCH_H__
+
+#include <stddef.h>
+
+#include "vector.h"
+
+/**
+ * Operations on arrays of vectors, such as the vertices of a shape,
+ * that process several vectors per SIMD instruction where the target
+ * supports it (AVX or SSE2 natively, 128-bit SIMD in WebAssembly).
+ * The arrays hold the vectors the simulation stores (see sim_vector_t), and
+ * twice as many fit in each SIMD register when it stores floats.
+ * Each gives the same results as applying the matching vec_* function to
+ * every vector in turn, up to rounding when it stores floats.
+ * The output array may be the same as the input array, but must not
+ * otherwise overlap it.
+ */
+
+/**
+ * Adds an offset to every vector in an array.
+ *
+ * @param out the array to write the results to
+ * @param in the vectors to translate
+ * @param n the number of vectors
+ * @param offset the vector to add to each one
+ */
+void vec_batch_translate(sim_vector_t *out, const sim_vector_t *in, size_t n,
+                         vector_t offset);
+
+/**
+ * Scales the components of every vector in an array separately,
+ * e.g. to stretch a shape.
+ *
+ * @param out the array to write the results to
+ * @param in the vectors to scale
+ * @param n the number of vectors
+ * @param scale the factors to multiply each vector's x and y by
+ */
+void vec_batch_scale(sim_vector_t *out, const sim_vector_t *in, size_t n,
+                     vector_t scale);
+
+/**
+ * Rotates every vector in an array around (0, 0).
+ * Takes the cosine and sine of the angle, so callers that rotate by the same
+ * angle repeatedly can compute them once.
+ *
+ * @param out the array to write the results to
+ * @param in the vectors to rotate
+ * @param n the number of vectors
+ * @param cos_angle the cosine of the angle to rotate by
+ * @param sin_angle the sine of the angle to rotate by
+ */
+void vec_batch_rotate(sim_vector_t *out, const sim_vector_t *in, size_t n,
+                      double cos_angle, double sin_angle);
+
+/**
+ * Rotates every vector in an array around (0, 0), then adds an offset,
+ * e.g. to move a shape from its own frame into the scene.
+ *
+ * @param out the array to write the results to
+ * @param in the vectors to transform
+ * @param n the number of vectors
+ * @param cos_angle the cosine of the angle to rotate by
+ * @param sin_angle the sine of the angle to rotate by
+ * @param offset the vector to add to each rotated vector
+ */
+void vec_batch_transform(sim_vector_t *out, const sim_vector_t *in, size_t n,
+                         double cos_angle, double sin_angle, vector_t offset);
+
+/**
+ * Projects every vector in an array onto an axis,
+ * and finds the largest and smallest projections.
+ *
+ * @param in the vectors to project
+ * @param n the number of vectors
+ * @param axis the axis to project onto (a unit vector for true lengths)
+ * @return a vector in the form (max, min) of the dot products with the axis;
+ * (-__DBL_MAX__, __DBL_MAX__) if the array is empty
+ */
+vector_t vec_batch_project(const sim_vector_t *in, size_t n, vector_t axis);
+
+/**
+ * Maps scene coordinates to window pixels: each vector is moved relative to
+ * the scene position at the center of the window, scaled, flipped
+ * vertically (since positive y is down on the screen), moved to the window's
+ * center and rounded to a whole pixel.
+ *
+ * @param out the array to write the pixel positions to
+ * @param in the scene positions
+ * @param n the number of vectors
+ * @param scene_center the scene position drawn at the center of the window
+ * @param scale the number of pixels per scene unit
+ * @param window_center the center of the window, in pixels
+ */
+void vec_batch_to_window(sim_vector_t *out, const sim_vector_t *in, size_t n,
+                         vector_t scene_center, double scale,
+                         vector_t window_center);
+
+#endif // #ifndef __VECTOR_BATCH_H__
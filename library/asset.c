@@ -2,23 +2,98 @@
 #include <SDL2/SDL_ttf.h>
 #include <assert.h>
 
+#include "array.h"
 #include "asset.h"
 #include "asset_cache.h"
 #include "color.h"
 #include "sdl_wrapper.h"
 
+/**
+ * The asset in one slot of the asset table, which handles index.
+ */
+typedef struct asset_slot {
+  // the asset, or NULL if the slot is free
+  asset_t *asset;
+  // how many assets have used the slot, counting from 1
+  uint32_t generation;
+  // whether the asset is marked for removal, by asset_remove_body() or by
+  // asset_flush_removed() being told its body was freed
+  bool removed;
+} asset_slot_t;
+
+// a growable array of asset slots
+ARRAY_DEFINE(asset_slot_list, asset_slot_t)
+// a growable array of slot indices
+ARRAY_DEFINE(slot_list, size_t)
+
+/**
+ * The assets drawn on the body in one body slot.
+ */
+typedef struct body_assets {
+  // the generation of the body the assets belong to; any other body in the
+  // slot has none yet
+  uint32_t generation;
+  // the assets' slots, in the order they were created
+  slot_list_t slots;
+} body_assets_t;
+
+// a growable array of the assets on each body, indexed by body slot
+ARRAY_DEFINE(body_assets_list, body_assets_t)
+
 static list_t *ASSET_LIST = NULL;
+// every live asset, indexed by its handle's slot
+static asset_slot_list_t ASSET_SLOTS = {0};
+// slots freed by asset_destroy(), reused before new ones are added
+static slot_list_t FREE_SLOTS = {0};
+// the reverse index from bodies to the assets drawn on them
+static body_assets_list_t BODY_ASSETS = {0};
+// the number of assets marked for removal
+static size_t NUM_REMOVED = 0;
 const size_t INIT_CAPACITY = 10;
 
+/**
+ * Finds the list of assets drawn on a body, optionally creating it.
+ *
+ * @param body a handle to the body
+ * @param create whether to make an empty list if the body has none
+ * @return the body's assets, or NULL if it has none and create is false
+ */
+static body_assets_t *body_assets_get(body_handle_t body, bool create) {
+  if (body.generation == 0) {
+    return NULL;
+  }
+  if (body.slot >= BODY_ASSETS.size) {
+    if (!create) {
+      return NULL;
+    }
+    while (BODY_ASSETS.size <= body.slot) {
+      body_assets_list_add(&BODY_ASSETS,
+                           (body_assets_t){.generation = 0, .slots = {0}});
+    }
+  }
+  body_assets_t *assets = &BODY_ASSETS.data[body.slot];
+  if (assets->generation != body.generation) {
+    if (!create) {
+      return NULL;
+    }
+    // the list belonged to a body that has been freed
+    assets->generation = body.generation;
+    slot_list_clear(&assets->slots);
+  }
+  return assets;
+}
+
 /**
  * Allocates memory for an asset with the given parameters.
  *
  * @param ty the type of the asset
  * @param bounding_box the bounding box containing the location and dimensions
  * of the asset when it is rendered
+ * @param body the body the asset is drawn on, or NULL
  * @return a pointer to the newly allocated asset
  */
-static asset_t *asset_init(asset_type_t ty, SDL_Rect bounding_box) {
+static asset_t *asset_init(asset_type_t ty, SDL_Rect bounding_box,
+                           body_t *body) {
   if (ASSET_LIST == NULL) {
     ASSET_LIST = list_init(INIT_CAPACITY, (free_func_t)asset_destroy);
   }
@@ -43,29 +118,45 @@ static asset_t *asset_init(asset_type_t ty, SDL_Rect bounding_box) {
   assert(new);
   new->type = ty;
   new->bounding_box = bounding_box;
+
+  size_t slot;
+  if (FREE_SLOTS.size > 0) {
+    slot = FREE_SLOTS.data[--FREE_SLOTS.size];
+  } else {
+    slot = ASSET_SLOTS.size;
+    asset_slot_list_add(&ASSET_SLOTS, (asset_slot_t){.generation = 1});
+  }
+  ASSET_SLOTS.data[slot].asset = new;
+  ASSET_SLOTS.data[slot].removed = false;
+  new->handle = (asset_handle_t){
+      .slot = slot, .generation = ASSET_SLOTS.data[slot].generation};
+
+  new->body = (body_handle_t){0};
+  if (body != NULL) {
+    new->body = body_get_handle(body);
+    slot_list_add(&body_assets_get(new->body, true)->slots, slot);
+  }
   return new;
 }
 
 void asset_make_image_with_body(const char *filepath, body_t *body) {
   SDL_Rect bounding_box = (SDL_Rect){.x = 0, .y = 0, .w = 0, .h = 0};
-  asset_t *asset = asset_init(ASSET_IMAGE, bounding_box);
+  asset_t *asset = asset_init(ASSET_IMAGE, bounding_box, body);
   image_asset_t *image_asset = (image_asset_t *)asset;
   image_asset->texture = asset_cache_obj_get_or_create(ASSET_IMAGE, filepath);
-  image_asset->body = body;
   list_add(ASSET_LIST, (asset_t *)image_asset);
 }
 
 void asset_make_image(const char *filepath, SDL_Rect bounding_box) {
-  asset_t *asset = asset_init(ASSET_IMAGE, bounding_box);
+  asset_t *asset = asset_init(ASSET_IMAGE, bounding_box, NULL);
   image_asset_t *image_asset = (image_asset_t *)asset;
   image_asset->texture = asset_cache_obj_get_or_create(ASSET_IMAGE, filepath);
-  image_asset->body = NULL;
   list_add(ASSET_LIST, (asset_t *)image_asset);
 }
 
 void asset_make_text(const char *filepath, SDL_Rect bounding_box,
                      const char *text, color_t color) {
-  asset_t *asset = asset_init(ASSET_TEXT, bounding_box);
+  asset_t *asset = asset_init(ASSET_TEXT, bounding_box, NULL);
   text_asset_t *text_asset = (text_asset_t *)asset;
   text_asset->font = asset_cache_obj_get_or_create(ASSET_TEXT, filepath);
   text_asset->text = text;
@@ -76,7 +167,7 @@ void asset_make_text(const char *filepath, SDL_Rect bounding_box,
 void asset_make_spirit(const char *front_filepath, const char *left_filepath,
                        const char *right_filepath, body_t *body) {
   SDL_Rect bounding_box = (SDL_Rect){.x = 0, .y = 0, .w = 0, .h = 0};
-  asset_t *asset = asset_init(ASSET_SPIRIT, bounding_box);
+  asset_t *asset = asset_init(ASSET_SPIRIT, bounding_box, body);
   spirit_asset_t *spirit_asset = (spirit_asset_t *)asset;
   spirit_asset->front_texture =
       asset_cache_obj_get_or_create(ASSET_IMAGE, front_filepath);
@@ -85,14 +176,13 @@ void asset_make_spirit(const char *front_filepath, const char *left_filepath,
   spirit_asset->left_texture =
       asset_cache_obj_get_or_create(ASSET_IMAGE, left_filepath);
   spirit_asset->curr_texture = spirit_asset->front_texture;
-  spirit_asset->body = body;
   list_add(ASSET_LIST, (asset_t *)spirit_asset);
 }
 
 void asset_make_anim(const char *frame1_filepath, const char *frame2_filepath,
                      const char *frame3_filepath, body_t *body) {
   SDL_Rect bounding_box = (SDL_Rect){.x = 0, .y = 0, .w = 0, .h = 0};
-  asset_t *asset = asset_init(ASSET_ANIM, bounding_box);
+  asset_t *asset = asset_init(ASSET_ANIM, bounding_box, body);
   anim_asset_t *anim_asset = (anim_asset_t *)asset;
   anim_asset->frame1_texture =
       asset_cache_obj_get_or_create(ASSET_IMAGE, frame1_filepath);
@@ -101,7 +191,6 @@ void asset_make_anim(const char *frame1_filepath, const char *frame2_filepath,
   anim_asset->frame3_texture =
       asset_cache_obj_get_or_create(ASSET_IMAGE, frame3_filepath);
   anim_asset->curr_texture = anim_asset->frame1_texture;
-  anim_asset->body = body;
   list_add(ASSET_LIST, (asset_t *)anim_asset);
 }
 
@@ -138,14 +227,13 @@ void asset_animate(asset_t *asset, double time) {
 void asset_make_button(const char *unpressed_filepath,
                        const char *pressed_filepath, body_t *body) {
   SDL_Rect bounding_box = {.x = 0, .y = 0, .w = 0, .h = 0};
-  asset_t *asset = asset_init(ASSET_BUTTON, bounding_box);
+  asset_t *asset = asset_init(ASSET_BUTTON, bounding_box, body);
   button_asset_t *button_asset = (button_asset_t *)asset;
   button_asset->unpressed_texture =
       asset_cache_obj_get_or_create(ASSET_IMAGE, unpressed_filepath);
   button_asset->pressed_texture =
       asset_cache_obj_get_or_create(ASSET_IMAGE, pressed_filepath);
   button_asset->curr_texture = button_asset->unpressed_texture;
-  button_asset->body = body;
   list_add(ASSET_LIST, (asset_t *)button_asset);
 }
 
@@ -160,68 +248,170 @@ void asset_reset_asset_list() {
     list_free(ASSET_LIST);
   }
   ASSET_LIST = list_init(INIT_CAPACITY, (free_func_t)asset_destroy);
+  NUM_REMOVED = 0;
+}
+
+void asset_free_all() {
+  if (ASSET_LIST != NULL) {
+    list_free(ASSET_LIST);
+    ASSET_LIST = NULL;
+  }
+  for (size_t i = 0; i < BODY_ASSETS.size; i++) {
+    slot_list_free(&BODY_ASSETS.data[i].slots);
+  }
+  body_assets_list_free(&BODY_ASSETS);
+  asset_slot_list_free(&ASSET_SLOTS);
+  slot_list_free(&FREE_SLOTS);
+  NUM_REMOVED = 0;
 }
 
 list_t *asset_get_asset_list() { return ASSET_LIST; }
 
+asset_handle_t asset_get_handle(asset_t *asset) { return asset->handle; }
+
+asset_t *asset_from_handle(asset_handle_t handle) {
+  if (handle.generation == 0 || handle.slot >= ASSET_SLOTS.size) {
+    return NULL;
+  }
+  asset_slot_t *slot = &ASSET_SLOTS.data[handle.slot];
+  return slot->generation == handle.generation ? slot->asset : NULL;
+}
+
+body_t *asset_get_body(asset_t *asset) { return body_from_handle(asset->body); }
+
+asset_t *asset_find_by_body(body_t *body, asset_type_t type) {
+  body_assets_t *assets = body_assets_get(body_get_handle(body), false);
+  if (assets == NULL) {
+    return NULL;
+  }
+  for (size_t i = 0; i < assets->slots.size; i++) {
+    asset_t *asset = ASSET_SLOTS.data[assets->slots.data[i]].asset;
+    if (asset->type == type) {
+      return asset;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Marks the image assets drawn on a body for removal.
+ *
+ * @param body a handle to the body, which may have been freed
+ */
+static void asset_remove_images(body_handle_t body) {
+  body_assets_t *assets = body_assets_get(body, false);
+  if (assets == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < assets->slots.size; i++) {
+    asset_slot_t *slot = &ASSET_SLOTS.data[assets->slots.data[i]];
+    if (slot->asset->type == ASSET_IMAGE && !slot->removed) {
+      slot->removed = true;
+      NUM_REMOVED++;
+    }
+  }
+}
+
 void asset_remove_body(body_t *body) {
+  asset_remove_images(body_get_handle(body));
+}
+
+void asset_flush_removed(const body_handle_t *bodies, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    asset_remove_images(bodies[i]);
+  }
+  if (NUM_REMOVED == 0) {
+    return;
+  }
+
   size_t len = list_size(ASSET_LIST);
+  // take every asset off the end of the list, which moves none of the
+  // others, then put back the ones to keep in their original order
+  asset_t **assets = malloc(sizeof(asset_t *) * len);
+  assert(assets);
+  for (size_t i = len; i > 0; i--) {
+    assets[i - 1] = list_remove(ASSET_LIST, i - 1);
+  }
   for (size_t i = 0; i < len; i++) {
-    asset_t *asset = list_get(ASSET_LIST, i);
-    if (asset->type == ASSET_IMAGE) {
-      image_asset_t *image_asset = (image_asset_t *)asset;
-      if (image_asset->body == body) {
-        list_remove(ASSET_LIST, i);
-        asset_destroy(asset);
-        i--;
-        len--;
-      }
+    asset_t *asset = assets[i];
+    if (ASSET_SLOTS.data[asset->handle.slot].removed) {
+      asset_destroy(asset);
+    } else {
+      list_add(ASSET_LIST, asset);
     }
   }
+  free(assets);
+  NUM_REMOVED = 0;
 }
 
-void asset_render(asset_t *asset) {
-  SDL_Rect box = asset->bounding_box;
+bool asset_get_render_box(asset_t *asset, SDL_Rect *box) {
+  *box = asset->bounding_box;
+  if (asset->body.generation != 0) {
+    body_t *body = asset_get_body(asset);
+    if (body == NULL) {
+      // the body was freed before the asset was removed
+      return false;
+    }
+    *box = sdl_get_body_bounding_box(body);
+  }
+  return true;
+}
+
+void asset_render_in(asset_t *asset, SDL_Rect *box) {
   switch (asset->type) {
   case ASSET_IMAGE: {
     image_asset_t *image = (image_asset_t *)asset;
-    if (image->body != NULL) {
-      box = sdl_get_body_bounding_box(image->body);
-    }
-    sdl_render_image(image->texture, &box);
+    sdl_render_image(image->texture, box);
     break;
   }
   case ASSET_TEXT: {
     text_asset_t *text_asset = (text_asset_t *)asset;
     sdl_render_text(text_asset->text, text_asset->font, text_asset->color,
-                    &box);
+                    box);
     break;
   }
   case ASSET_SPIRIT: {
     spirit_asset_t *spirit_asset = (spirit_asset_t *)asset;
-    if (spirit_asset->body != NULL) {
-      box = sdl_get_body_bounding_box(spirit_asset->body);
-    }
-    sdl_render_image(spirit_asset->curr_texture, &box);
+    sdl_render_image(spirit_asset->curr_texture, box);
     break;
   }
   case ASSET_BUTTON: {
     button_asset_t *button_asset = (button_asset_t *)asset;
-    if (button_asset->body != NULL) {
-      box = sdl_get_body_bounding_box(button_asset->body);
-    }
-    sdl_render_image(button_asset->curr_texture, &box);
+    sdl_render_image(button_asset->curr_texture, box);
     break;
   }
   case ASSET_ANIM: {
     anim_asset_t *anim_asset = (anim_asset_t *)asset;
-    if (anim_asset->body != NULL) {
-      box = sdl_get_body_bounding_box(anim_asset->body);
-    }
-    sdl_render_image(anim_asset->curr_texture, &box);
+    sdl_render_image(anim_asset->curr_texture, box);
     break;
   }
   }
 }
 
-void asset_destroy(asset_t *asset) { free(asset); }
\ No newline at end of file
+void asset_render(asset_t *asset) {
+  SDL_Rect box;
+  if (asset_get_render_box(asset, &box)) {
+    asset_render_in(asset, &box);
+  }
+}
+
+void asset_destroy(asset_t *asset) {
+  asset_slot_t *slot = &ASSET_SLOTS.data[asset->handle.slot];
+  body_assets_t *assets = body_assets_get(asset->body, false);
+  if (assets != NULL) {
+    // keep the body's other assets in the order they were created
+    for (size_t i = 0; i < assets->slots.size; i++) {
+      if (assets->slots.data[i] == asset->handle.slot) {
+        slot_list_remove(&assets->slots, i);
+        break;
+      }
+    }
+  }
+  slot->asset = NULL;
+  slot->removed = false;
+  if (++slot->generation == 0) {
+    slot->generation = 1;
+  }
+  slot_list_add(&FREE_SLOTS, asset->handle.slot);
+  free(asset);
+}
@@ -0,0 +1,792 @@
+#include "body.h"
+#include "vector_batch.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+const size_t INIT_SLOTS = 64;
+const size_t INIT_VERTICES = 512;
+
+/**
+ * Which of a body's cached world-space values are out of date.
+ */
+typedef enum {
+  DIRTY_VERTICES = 1 << 0,
+  DIRTY_BOX = 1 << 1,
+  DIRTY_NORMALS = 1 << 2,
+} dirty_t;
+
+// the size of a cache line; each body's motion starts on a new one
+#define CACHE_LINE 64
+
+/**
+ * The state of a body that integration and the broadphase read every tick,
+ * packed into two cache lines (one when the simulation stores floats):
+ * what body_tick() reads and writes, then what placing the body's shape needs.
+ */
+typedef struct body_motion {
+  _Alignas(CACHE_LINE) sim_vector_t centroid;
+  sim_vector_t velocity;
+  sim_vector_t force;
+  sim_vector_t impulse;
+  sim_real_t mass;
+  sim_real_t rotation;
+  sim_real_t cos_rotation;
+  sim_real_t sin_rotation;
+  sim_vector_t box_min;
+  sim_vector_t box_max;
+} body_motion_t;
+
+struct shape_template {
+  size_t refs;
+  size_t count;
+  // the centroid of the vertices the template was made from
+  vector_t centroid;
+  // the vertices, about the centroid
+  sim_vector_t *vertices;
+  // the unit normal of the edge from each vertex to the next
+  sim_vector_t *normals;
+  aabb_t box;
+  double area;
+};
+
+/**
+ * A body's shape, and where its world-space geometry is cached in the
+ * store's vertex arrays, read only when that geometry is recomputed.
+ */
+typedef struct body_shape {
+  shape_template_t *shape;
+  vector_t scale;
+  // the template's box, scaled
+  aabb_t local_box;
+  size_t first_vertex;
+  size_t vertex_count;
+} body_shape_t;
+
+/**
+ * The state of a body that the simulation never reads.
+ */
+typedef struct body_cold {
+  // the body in the slot, or NULL if the slot is free
+  body_t *owner;
+  // how many bodies have used the slot, counting from 1; see body_handle_t
+  uint32_t generation;
+  color_t color;
+  void *info;
+  free_func_t info_freer;
+  // the pose saved by body_save_pose(), for drawing between ticks;
+  // until one is saved, the body is drawn where it is
+  bool pose_saved;
+  vector_t prev_centroid;
+  double prev_rotation;
+} body_cold_t;
+
+/**
+ * The state of every body, kept in arrays of records indexed by the body's
+ * slot rather than in each body_t, and split by how often it is used,
+ * so that loops over many bodies only bring what they use into the cache.
+ * Shapes are shape templates, in local space about the centroid and
+ * unrotated, which bodies with the same shape share; each body scales its
+ * template.
+ * The world-space vertices, edge normals and bounding box are caches that
+ * are only recomputed when read after the body has moved or rotated.
+ * The cached vertices and normals of all bodies share one array each; each
+ * body owns a contiguous range of them.
+ */
+typedef struct body_store {
+  size_t num_slots;
+  size_t capacity;
+  body_motion_t *motion;
+  body_shape_t *shape;
+  body_cold_t *cold;
+
+  // slots released by body_free(), reused before new ones are added
+  size_t *free_slots;
+  size_t num_free_slots;
+
+  // the vertex arrays both have the same layout
+  sim_vector_t *vertices;
+  sim_vector_t *normals;
+  size_t num_vertices;
+  size_t vertex_capacity;
+  // vertices in the arrays that belong to freed bodies
+  size_t dead_vertices;
+} body_store_t;
+
+static body_store_t store = {0};
+
+// the names of the interned kinds, indexed by kind; kind 0 has no name
+static char **kind_names = NULL;
+static size_t num_kinds = 1;
+
+/**
+ * A handle to a body's slot in the store, along with the flags that scenes
+ * check for every body every tick.
+ */
+struct body {
+  size_t slot;
+  body_type_t type;
+  uint32_t category;
+  uint32_t mask;
+  body_kind_t kind;
+  // which of the body's cached values are stale; see dirty_t
+  uint8_t dirty;
+  bool removed;
+  bool sleeping;
+  bool fast;
+  bool sensor;
+};
+
+/**
+ * Grows one of the store's arrays.
+ * Asserts that the required memory is successfully allocated.
+ */
+static void *store_grow(void *array, size_t size, size_t capacity) {
+  array = realloc(array, size * capacity);
+  assert(array);
+  return array;
+}
+
+/**
+ * Grows one of the store's arrays of records that start on a cache line,
+ * which realloc() does not guarantee.
+ * Asserts that the required memory is successfully allocated.
+ */
+static void *store_grow_aligned(void *array, size_t size, size_t old_capacity,
+                                size_t capacity) {
+  void *grown = aligned_alloc(CACHE_LINE, size * capacity);
+  assert(grown);
+  if (array != NULL) {
+    memcpy(grown, array, size * old_capacity);
+    free(array);
+  }
+  return grown;
+}
+
+/**
+ * Returns an unused slot in the store, growing its arrays if it is full.
+ *
+ * @param body the body that will own the slot
+ * @return the slot's index
+ */
+static size_t store_add_slot(body_t *body) {
+  size_t slot;
+  if (store.num_free_slots > 0) {
+    slot = store.free_slots[--store.num_free_slots];
+  } else {
+    if (store.num_slots == store.capacity) {
+      size_t capacity = store.capacity == 0 ? INIT_SLOTS : store.capacity * 2;
+      store.motion = store_grow_aligned(store.motion, sizeof(body_motion_t),
+                                        store.capacity, capacity);
+      store.shape = store_grow(store.shape, sizeof(body_shape_t), capacity);
+      store.cold = store_grow(store.cold, sizeof(body_cold_t), capacity);
+      store.free_slots = store_grow(store.free_slots, sizeof(size_t), capacity);
+      store.capacity = capacity;
+    }
+    slot = store.num_slots++;
+    store.cold[slot].generation = 1;
+  }
+  store.cold[slot].owner = body;
+  return slot;
+}
+
+/**
+ * Copies the live ranges of one of the vertex arrays to the start of a new
+ * array, in slot order.
+ *
+ * @param array the array to compact, which is freed
+ * @return the compacted array
+ */
+static sim_vector_t *store_compact_array(sim_vector_t *array) {
+  sim_vector_t *compacted =
+      malloc(sizeof(sim_vector_t) * store.vertex_capacity);
+  assert(compacted);
+  size_t num_vertices = 0;
+  for (size_t slot = 0; slot < store.num_slots; slot++) {
+    if (store.cold[slot].owner == NULL) {
+      continue;
+    }
+    size_t count = store.shape[slot].vertex_count;
+    for (size_t i = 0; i < count; i++) {
+      compacted[num_vertices + i] = array[store.shape[slot].first_vertex + i];
+    }
+    num_vertices += count;
+  }
+  free(array);
+  return compacted;
+}
+
+/**
+ * Moves every live body's vertices to the start of the vertex arrays,
+ * dropping the ranges of freed bodies.
+ */
+static void store_compact_vertices(void) {
+  store.vertices = store_compact_array(store.vertices);
+  store.normals = store_compact_array(store.normals);
+
+  size_t num_vertices = 0;
+  for (size_t slot = 0; slot < store.num_slots; slot++) {
+    if (store.cold[slot].owner != NULL) {
+      store.shape[slot].first_vertex = num_vertices;
+      num_vertices += store.shape[slot].vertex_count;
+    }
+  }
+  store.num_vertices = num_vertices;
+  store.dead_vertices = 0;
+}
+
+/**
+ * Reserves a contiguous range of the vertex arrays.
+ * Compacts the arrays instead of growing them if at least half is dead.
+ *
+ * @param count the number of vertices needed
+ * @return the index of the first vertex in the range
+ */
+static size_t store_add_vertices(size_t count) {
+  if (store.num_vertices + count > store.vertex_capacity &&
+      store.dead_vertices > 0 &&
+      store.dead_vertices * 2 >= store.num_vertices) {
+    store_compact_vertices();
+  }
+  if (store.num_vertices + count > store.vertex_capacity) {
+    size_t capacity =
+        store.vertex_capacity == 0 ? INIT_VERTICES : store.vertex_capacity;
+    while (store.num_vertices + count > capacity) {
+      capacity *= 2;
+    }
+    store.vertices = store_grow(store.vertices, sizeof(sim_vector_t), capacity);
+    store.normals = store_grow(store.normals, sizeof(sim_vector_t), capacity);
+    store.vertex_capacity = capacity;
+  }
+  size_t first = store.num_vertices;
+  store.num_vertices += count;
+  return first;
+}
+
+/**
+ * Returns a pointer to the first of a body's world-space vertices,
+ * recomputing them from its local shape and transform if they are stale.
+ * It is invalidated when any body is created.
+ */
+static sim_vector_t *body_vertices(body_t *body) {
+  body_motion_t *motion = &store.motion[body->slot];
+  body_shape_t *shape = &store.shape[body->slot];
+  size_t first = shape->first_vertex;
+  if (body->dirty & DIRTY_VERTICES) {
+    sim_vector_t *out = &store.vertices[first];
+    const sim_vector_t *local = shape->shape->vertices;
+    size_t n = shape->vertex_count;
+    if (shape->scale.x != 1 || shape->scale.y != 1) {
+      vec_batch_scale(out, local, n, shape->scale);
+      local = out;
+    }
+    vector_t centroid = vec_from_sim(motion->centroid);
+    if (motion->rotation == 0) {
+      vec_batch_translate(out, local, n, centroid);
+    } else {
+      vec_batch_transform(out, local, n, motion->cos_rotation,
+                          motion->sin_rotation, centroid);
+    }
+    body->dirty &= ~DIRTY_VERTICES;
+  }
+  return &store.vertices[first];
+}
+
+/**
+ * Marks a body's cached world-space values as stale after it has moved,
+ * or rotated if rotated is true.
+ */
+static void body_invalidate(body_t *body, bool rotated) {
+  body->dirty |= DIRTY_VERTICES | DIRTY_BOX;
+  if (rotated) {
+    body->dirty |= DIRTY_NORMALS;
+  }
+}
+
+/**
+ * Computes the center of mass of a polygon.
+ * See https://en.wikipedia.org/wiki/Centroid#Of_a_polygon.
+ *
+ * @param vertices the vertices of the polygon
+ * @param n the number of vertices
+ * @return the centroid of the polygon
+ */
+static vector_t polygon_centroid(const vector_t *vertices, size_t n) {
+  double area = 0;
+  vector_t sum = VEC_ZERO;
+  for (size_t i = 0; i < n; i++) {
+    vector_t v1 = vertices[i];
+    vector_t v2 = vertices[(i + 1) % n];
+    double cross = vec_cross(v1, v2);
+    area += cross;
+    sum = vec_add(sum, vec_multiply(cross, vec_add(v1, v2)));
+  }
+  area /= 2;
+  return vec_multiply(1 / (6 * area), sum);
+}
+
+body_t *body_init(list_t *shape, double mass, color_t color) {
+  return body_init_with_info(shape, mass, color, NULL, NULL);
+}
+
+body_t *body_init_with_info(list_t *shape, double mass, color_t color,
+                            void *info, free_func_t info_freer) {
+  vector_array_t vertices = vector_array_init(list_size(shape));
+  for (size_t i = 0; i < list_size(shape); i++) {
+    vector_array_add(&vertices, *(vector_t *)list_get(shape, i));
+  }
+  list_free(shape);
+  body_t *body =
+      body_init_with_shape(&vertices, mass, color, info, info_freer);
+  vector_array_free(&vertices);
+  return body;
+}
+
+shape_template_t *shape_template_init(const vector_array_t *vertices) {
+  shape_template_t *shape = malloc(sizeof(shape_template_t));
+  assert(shape);
+  size_t n = vertices->size;
+  shape->refs = 1;
+  shape->count = n;
+  shape->centroid = polygon_centroid(vertices->data, n);
+  shape->vertices = malloc(sizeof(sim_vector_t) * n);
+  shape->normals = malloc(sizeof(sim_vector_t) * n);
+  assert(shape->vertices);
+  assert(shape->normals);
+
+  aabb_t box = {.min = {INFINITY, INFINITY}, .max = {-INFINITY, -INFINITY}};
+  double area = 0;
+  for (size_t i = 0; i < n; i++) {
+    shape->vertices[i] =
+        vec_to_sim(vec_subtract(vertices->data[i], shape->centroid));
+    // measure the vertices as stored, which may have been rounded
+    vector_t v = vec_from_sim(shape->vertices[i]);
+    box.min.x = fmin(box.min.x, v.x);
+    box.min.y = fmin(box.min.y, v.y);
+    box.max.x = fmax(box.max.x, v.x);
+    box.max.y = fmax(box.max.y, v.y);
+  }
+  for (size_t i = 0; i < n; i++) {
+    vector_t v1 = vec_from_sim(shape->vertices[i]);
+    vector_t v2 = vec_from_sim(shape->vertices[(i + 1) % n]);
+    // the edge from vertex i to vertex i + 1, turned a quarter clockwise
+    vector_t edge = vec_subtract(v2, v1);
+    double length = vec_get_length(edge);
+    shape->normals[i] = vec_to_sim(
+        length > 0 ? (vector_t){.x = edge.y / length, .y = -edge.x / length}
+                   : VEC_ZERO);
+    area += vec_cross(v1, v2);
+  }
+  shape->box = box;
+  shape->area = fabs(area) / 2;
+  return shape;
+}
+
+shape_template_t *shape_template_retain(shape_template_t *shape) {
+  shape->refs++;
+  return shape;
+}
+
+void shape_template_release(shape_template_t *shape) {
+  assert(shape->refs > 0);
+  if (--shape->refs > 0) {
+    return;
+  }
+  free(shape->vertices);
+  free(shape->normals);
+  free(shape);
+}
+
+body_t *body_init_with_shape(const vector_array_t *shape, double mass,
+                             color_t color, void *info,
+                             free_func_t info_freer) {
+  shape_template_t *own_shape = shape_template_init(shape);
+  body_t *body = body_init_with_template(
+      own_shape, (vector_t){.x = 1, .y = 1}, mass, color, info, info_freer);
+  shape_template_release(own_shape);
+  return body;
+}
+
+body_t *body_init_with_template(shape_template_t *shape, vector_t scale,
+                                double mass, color_t color, void *info,
+                                free_func_t info_freer) {
+  assert(scale.x > 0 && scale.y > 0);
+  body_t *body = malloc(sizeof(body_t));
+  assert(body);
+  // reserve the vertices first, since that may compact the arrays,
+  // which reads every slot in use
+  size_t first = store_add_vertices(shape->count);
+  size_t slot = store_add_slot(body);
+  body->slot = slot;
+
+  aabb_t box = shape->box;
+  store.shape[slot] = (body_shape_t){
+      .shape = shape_template_retain(shape),
+      .scale = scale,
+      .local_box = {.min = {box.min.x * scale.x, box.min.y * scale.y},
+                    .max = {box.max.x * scale.x, box.max.y * scale.y}},
+      .first_vertex = first,
+      .vertex_count = shape->count};
+  vector_t centroid = {.x = shape->centroid.x * scale.x,
+                       .y = shape->centroid.y * scale.y};
+  store.motion[slot] = (body_motion_t){.centroid = vec_to_sim(centroid),
+                                       .velocity = vec_to_sim(VEC_ZERO),
+                                       .force = vec_to_sim(VEC_ZERO),
+                                       .impulse = vec_to_sim(VEC_ZERO),
+                                       .mass = mass,
+                                       .rotation = 0,
+                                       .cos_rotation = 1,
+                                       .sin_rotation = 0};
+  store.cold[slot] = (body_cold_t){.owner = body,
+                                   .generation = store.cold[slot].generation,
+                                   .color = color,
+                                   .info = info,
+                                   .info_freer = info_freer,
+                                   .pose_saved = false};
+  body->dirty = DIRTY_VERTICES | DIRTY_BOX | DIRTY_NORMALS;
+  body->type = BODY_DYNAMIC;
+  body->removed = false;
+  body->sleeping = false;
+  body->fast = false;
+  body->sensor = false;
+  body->category = 0;
+  body->mask = UINT32_MAX;
+  body->kind = BODY_KIND_NONE;
+  return body;
+}
+
+list_t *body_get_shape(body_t *body) {
+  size_t n = store.shape[body->slot].vertex_count;
+  sim_vector_t *vertices = body_vertices(body);
+  list_t *shape = list_init(n, free);
+  for (size_t i = 0; i < n; i++) {
+    vector_t *v = malloc(sizeof(vector_t));
+    assert(v);
+    *v = vec_from_sim(vertices[i]);
+    list_add(shape, v);
+  }
+  return shape;
+}
+
+shape_view_t body_get_shape_view(body_t *body) {
+  return (shape_view_t){.vertices = body_vertices(body),
+                        .count = store.shape[body->slot].vertex_count};
+}
+
+shape_view_t body_get_edge_normals(body_t *body) {
+  body_motion_t *motion = &store.motion[body->slot];
+  body_shape_t *shape = &store.shape[body->slot];
+  size_t first = shape->first_vertex;
+  size_t n = shape->vertex_count;
+  if (body->dirty & DIRTY_NORMALS) {
+    sim_vector_t *out = &store.normals[first];
+    const sim_vector_t *local = shape->shape->normals;
+    vector_t scale = shape->scale;
+    if (scale.x != 1 || scale.y != 1) {
+      // stretching a shape divides its normals by the scale
+      for (size_t i = 0; i < n; i++) {
+        vector_t normal = {.x = local[i].x / scale.x,
+                           .y = local[i].y / scale.y};
+        double length = vec_get_length(normal);
+        out[i] = vec_to_sim(length > 0 ? vec_multiply(1 / length, normal)
+                                       : VEC_ZERO);
+      }
+      local = out;
+    }
+    vec_batch_rotate(out, local, n, motion->cos_rotation,
+                     motion->sin_rotation);
+    body->dirty &= ~DIRTY_NORMALS;
+  }
+  return (shape_view_t){.vertices = &store.normals[first], .count = n};
+}
+
+aabb_t body_get_bounding_box(body_t *body) {
+  body_motion_t *motion = &store.motion[body->slot];
+  if (!(body->dirty & DIRTY_BOX)) {
+    return (aabb_t){.min = vec_from_sim(motion->box_min),
+                    .max = vec_from_sim(motion->box_max)};
+  }
+
+  aabb_t box;
+  if (motion->rotation == 0) {
+    // unrotated bodies only need their local box moved
+    aabb_t local_box = store.shape[body->slot].local_box;
+    box.min = vec_add(local_box.min, vec_from_sim(motion->centroid));
+    box.max = vec_add(local_box.max, vec_from_sim(motion->centroid));
+  } else {
+    sim_vector_t *vertices = body_vertices(body);
+    size_t n = store.shape[body->slot].vertex_count;
+    vector_t x = vec_batch_project(vertices, n, (vector_t){.x = 1, .y = 0});
+    vector_t y = vec_batch_project(vertices, n, (vector_t){.x = 0, .y = 1});
+    box = (aabb_t){.min = {.x = x.y, .y = y.y}, .max = {.x = x.x, .y = y.x}};
+  }
+  motion->box_min = vec_to_sim(box.min);
+  motion->box_max = vec_to_sim(box.max);
+  body->dirty &= ~DIRTY_BOX;
+  return (aabb_t){.min = vec_from_sim(motion->box_min),
+                  .max = vec_from_sim(motion->box_max)};
+}
+
+void *body_get_info(body_t *body) { return store.cold[body->slot].info; }
+
+vector_t body_get_centroid(body_t *body) {
+  return vec_from_sim(store.motion[body->slot].centroid);
+}
+
+void body_set_centroid(body_t *body, vector_t x) {
+  store.motion[body->slot].centroid = vec_to_sim(x);
+  body->sleeping = false;
+  body_invalidate(body, false);
+}
+
+vector_t body_get_velocity(body_t *body) {
+  return vec_from_sim(store.motion[body->slot].velocity);
+}
+
+void body_set_velocity(body_t *body, vector_t v) {
+  store.motion[body->slot].velocity = vec_to_sim(v);
+  body->sleeping = false;
+}
+
+double body_area(body_t *body) {
+  body_shape_t *shape = &store.shape[body->slot];
+  return shape->shape->area * shape->scale.x * shape->scale.y;
+}
+
+color_t body_get_color(body_t *body) { return store.cold[body->slot].color; }
+
+void body_set_color(body_t *body, color_t color) {
+  store.cold[body->slot].color = color;
+}
+
+double body_get_rotation(body_t *body) {
+  return store.motion[body->slot].rotation;
+}
+
+void body_set_rotation(body_t *body, double angle) {
+  body_motion_t *motion = &store.motion[body->slot];
+  if (angle == motion->rotation) {
+    return;
+  }
+  motion->rotation = angle;
+  body->sleeping = false;
+  motion->cos_rotation = cos(angle);
+  motion->sin_rotation = sin(angle);
+  body_invalidate(body, true);
+}
+
+void body_save_pose(body_t *body) {
+  body_motion_t *motion = &store.motion[body->slot];
+  body_cold_t *cold = &store.cold[body->slot];
+  cold->pose_saved = true;
+  cold->prev_centroid = vec_from_sim(motion->centroid);
+  cold->prev_rotation = motion->rotation;
+}
+
+vector_t body_get_interpolated_centroid(body_t *body, double alpha) {
+  body_cold_t *cold = &store.cold[body->slot];
+  vector_t curr = vec_from_sim(store.motion[body->slot].centroid);
+  if (!cold->pose_saved) {
+    return curr;
+  }
+  vector_t prev = cold->prev_centroid;
+  return vec_add(prev, vec_multiply(alpha, vec_subtract(curr, prev)));
+}
+
+double body_get_interpolated_rotation(body_t *body, double alpha) {
+  body_cold_t *cold = &store.cold[body->slot];
+  double curr = store.motion[body->slot].rotation;
+  if (!cold->pose_saved) {
+    return curr;
+  }
+  return cold->prev_rotation + alpha * (curr - cold->prev_rotation);
+}
+
+void body_tick(body_t *body, double dt) {
+  body_motion_t *motion = &store.motion[body->slot];
+  if (body->type == BODY_STATIC) {
+    return;
+  }
+  vector_t centroid = vec_from_sim(motion->centroid);
+  if (body->type == BODY_KINEMATIC) {
+    vector_t velocity = vec_from_sim(motion->velocity);
+    if (velocity.x != 0 || velocity.y != 0) {
+      body_set_centroid(body, vec_add(centroid, vec_multiply(dt, velocity)));
+    }
+    return;
+  }
+
+  double mass = motion->mass;
+  vector_t old_velocity = vec_from_sim(motion->velocity);
+  vector_t force = vec_from_sim(motion->force);
+  vector_t impulse = vec_from_sim(motion->impulse);
+  vector_t new_velocity =
+      vec_add(vec_add(old_velocity, vec_multiply(dt / mass, force)),
+              vec_multiply(1 / mass, impulse));
+  vector_t average = vec_multiply(0.5, vec_add(old_velocity, new_velocity));
+  if (average.x != 0 || average.y != 0) {
+    body_set_centroid(body, vec_add(centroid, vec_multiply(dt, average)));
+  }
+  motion->velocity = vec_to_sim(new_velocity);
+  motion->force = vec_to_sim(VEC_ZERO);
+  motion->impulse = vec_to_sim(VEC_ZERO);
+}
+
+double body_get_mass(body_t *body) { return store.motion[body->slot].mass; }
+
+void body_add_force(body_t *body, vector_t force) {
+  if (body->type != BODY_DYNAMIC) {
+    return;
+  }
+  if (force.x != 0 || force.y != 0) {
+    body->sleeping = false;
+  }
+  body_motion_t *motion = &store.motion[body->slot];
+  motion->force = vec_to_sim(vec_add(vec_from_sim(motion->force), force));
+}
+
+vector_t body_get_force(body_t *body) {
+  return vec_from_sim(store.motion[body->slot].force);
+}
+
+void body_add_impulse(body_t *body, vector_t impulse) {
+  if (body->type != BODY_DYNAMIC) {
+    return;
+  }
+  if (impulse.x != 0 || impulse.y != 0) {
+    body->sleeping = false;
+  }
+  body_motion_t *motion = &store.motion[body->slot];
+  motion->impulse = vec_to_sim(vec_add(vec_from_sim(motion->impulse), impulse));
+}
+
+vector_t body_get_impulse(body_t *body) {
+  return vec_from_sim(store.motion[body->slot].impulse);
+}
+
+void body_reset(body_t *body) {
+  store.motion[body->slot].force = vec_to_sim(VEC_ZERO);
+  store.motion[body->slot].impulse = vec_to_sim(VEC_ZERO);
+}
+
+void body_remove(body_t *body) { body->removed = true; }
+
+bool body_is_removed(body_t *body) { return body->removed; }
+
+void body_set_type(body_t *body, body_type_t type) {
+  body->type = type;
+  body_reset(body);
+}
+
+body_type_t body_get_type(body_t *body) { return body->type; }
+
+void body_set_sleeping(body_t *body, bool sleeping) {
+  if (sleeping) {
+    store.motion[body->slot].velocity = vec_to_sim(VEC_ZERO);
+    body_reset(body);
+  }
+  body->sleeping = sleeping;
+}
+
+bool body_is_sleeping(body_t *body) { return body->sleeping; }
+
+void body_set_fast(body_t *body, bool fast) { body->fast = fast; }
+
+bool body_is_fast(body_t *body) { return body->fast; }
+
+void body_set_sensor(body_t *body, bool sensor) { body->sensor = sensor; }
+
+bool body_is_sensor(body_t *body) { return body->sensor; }
+
+void body_set_category(body_t *body, uint32_t category) {
+  body->category = category;
+}
+
+uint32_t body_get_category(body_t *body) { return body->category; }
+
+void body_set_mask(body_t *body, uint32_t mask) { body->mask = mask; }
+
+uint32_t body_get_mask(body_t *body) { return body->mask; }
+
+body_kind_t body_kind_intern(const char *name) {
+  // there are only a handful of kinds, and they are interned while levels are
+  // built rather than every tick
+  for (size_t i = 1; i < num_kinds; i++) {
+    if (strcmp(kind_names[i], name) == 0) {
+      return (body_kind_t)i;
+    }
+  }
+  kind_names = realloc(kind_names, sizeof(char *) * (num_kinds + 1));
+  assert(kind_names);
+  kind_names[0] = NULL;
+  kind_names[num_kinds] = strdup(name);
+  assert(kind_names[num_kinds]);
+  return (body_kind_t)num_kinds++;
+}
+
+const char *body_kind_name(body_kind_t kind) {
+  assert(kind < num_kinds);
+  return kind == BODY_KIND_NONE ? NULL : kind_names[kind];
+}
+
+size_t body_kind_count(void) { return num_kinds; }
+
+void body_kinds_free(void) {
+  for (size_t i = 1; i < num_kinds; i++) {
+    free(kind_names[i]);
+  }
+  free(kind_names);
+  kind_names = NULL;
+  num_kinds = 1;
+}
+
+void body_store_free(void) {
+  assert(store.num_free_slots == store.num_slots);
+  free(store.motion);
+  free(store.shape);
+  free(store.cold);
+  free(store.free_slots);
+  free(store.vertices);
+  free(store.normals);
+  store = (body_store_t){0};
+}
+
+void body_set_kind(body_t *body, body_kind_t kind) {
+  assert(kind < num_kinds);
+  body->kind = kind;
+}
+
+body_kind_t body_get_kind(body_t *body) { return body->kind; }
+
+body_handle_t body_get_handle(body_t *body) {
+  return (body_handle_t){.slot = body->slot,
+                         .generation = store.cold[body->slot].generation};
+}
+
+body_t *body_from_handle(body_handle_t handle) {
+  if (handle.generation == 0 || handle.slot >= store.num_slots) {
+    return NULL;
+  }
+  body_cold_t *cold = &store.cold[handle.slot];
+  return cold->generation == handle.generation ? cold->owner : NULL;
+}
+
+void body_free(body_t *body) {
+  size_t slot = body->slot;
+  body_cold_t *cold = &store.cold[slot];
+  cold->owner = NULL;
+  // stale handles to the body no longer match; 0 is never a generation
+  if (++cold->generation == 0) {
+    cold->generation = 1;
+  }
+  shape_template_release(store.shape[slot].shape);
+  store.dead_vertices += store.shape[slot].vertex_count;
+  store.free_slots[store.num_free_slots++] = slot;
+  if (cold->info_freer != NULL) {
+    cold->info_freer(cold->info);
+  }
+  free(body);
+}
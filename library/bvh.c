@@ -0,0 +1,366 @@
+#include "bvh.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+/**
+ * The most bodies stored in a single leaf of the hierarchy.
+ */
+const size_t BVH_LEAF_SIZE = 4;
+
+typedef struct bvh_entry {
+  aabb_t box;
+  body_t *body;
+  size_t index;
+} bvh_entry_t;
+
+/**
+ * A node of the hierarchy. Leaves hold the entries from start to
+ * start + count; other nodes have count 0 and two children.
+ */
+typedef struct bvh_node {
+  aabb_t box;
+  size_t left;
+  size_t right;
+  size_t start;
+  size_t count;
+} bvh_node_t;
+
+struct bvh {
+  aabb_t *boxes;
+  bvh_entry_t *entries;
+  size_t num_entries;
+  bvh_node_t *nodes;
+  size_t num_nodes;
+};
+
+aabb_t aabb_from_body(body_t *body) { return body_get_bounding_box(body); }
+
+/**
+ * Returns the smallest box containing two boxes.
+ */
+static aabb_t aabb_union(aabb_t a, aabb_t b) {
+  return (aabb_t){.min = {fmin(a.min.x, b.min.x), fmin(a.min.y, b.min.y)},
+                  .max = {fmax(a.max.x, b.max.x), fmax(a.max.y, b.max.y)}};
+}
+
+/**
+ * Returns whether the union of two boxes is itself a box, i.e. one contains
+ * the other, or they share two opposite sides and touch or overlap between
+ * them.
+ */
+static bool aabb_can_merge(aabb_t a, aabb_t b) {
+  bool same_rows = a.min.y == b.min.y && a.max.y == b.max.y;
+  bool same_columns = a.min.x == b.min.x && a.max.x == b.max.x;
+  bool touch_x = a.min.x <= b.max.x && b.min.x <= a.max.x;
+  bool touch_y = a.min.y <= b.max.y && b.min.y <= a.max.y;
+  bool a_in_b = b.min.x <= a.min.x && a.max.x <= b.max.x &&
+                b.min.y <= a.min.y && a.max.y <= b.max.y;
+  bool b_in_a = a.min.x <= b.min.x && b.max.x <= a.max.x &&
+                a.min.y <= b.min.y && b.max.y <= a.max.y;
+  return (same_rows && touch_x) || (same_columns && touch_y) || a_in_b ||
+         b_in_a;
+}
+
+size_t aabb_merge(aabb_t *boxes, size_t count) {
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t i = 0; i < count; i++) {
+      size_t j = i + 1;
+      while (j < count) {
+        if (aabb_can_merge(boxes[i], boxes[j])) {
+          boxes[i] = aabb_union(boxes[i], boxes[j]);
+          boxes[j] = boxes[--count];
+          merged = true;
+        } else {
+          j++;
+        }
+      }
+    }
+  }
+  return count;
+}
+
+/**
+ * Returns the center of an entry's box along the x (0) or y (1) axis.
+ */
+static double entry_center(bvh_entry_t *entry, int axis) {
+  return axis == 0 ? entry->box.min.x + entry->box.max.x
+                   : entry->box.min.y + entry->box.max.y;
+}
+
+/**
+ * Swaps two entries.
+ */
+static void swap_entries(bvh_entry_t *a, bvh_entry_t *b) {
+  bvh_entry_t temp = *a;
+  *a = *b;
+  *b = temp;
+}
+
+/**
+ * Reorders entries so the one at index nth has the center it would have if
+ * they were sorted along an axis, with smaller centers before it and larger
+ * ones after it.
+ *
+ * @param entries the entries to reorder
+ * @param count the number of entries
+ * @param nth the index to place
+ * @param axis 0 to compare x coordinates, 1 to compare y coordinates
+ */
+static void select_nth(bvh_entry_t *entries, size_t count, size_t nth,
+                       int axis) {
+  size_t lo = 0;
+  size_t hi = count - 1;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    swap_entries(&entries[mid], &entries[hi]);
+    double pivot = entry_center(&entries[hi], axis);
+    size_t store = lo;
+    for (size_t i = lo; i < hi; i++) {
+      if (entry_center(&entries[i], axis) < pivot) {
+        swap_entries(&entries[i], &entries[store]);
+        store++;
+      }
+    }
+    swap_entries(&entries[store], &entries[hi]);
+
+    if (nth == store) {
+      return;
+    } else if (nth < store) {
+      hi = store - 1;
+    } else {
+      lo = store + 1;
+    }
+  }
+}
+
+/**
+ * Builds the subtree over a range of entries.
+ *
+ * @param bvh the hierarchy being built
+ * @param start the index of the first entry in the range
+ * @param count the number of entries in the range, at least 1
+ * @return the index of the subtree's root node
+ */
+static size_t bvh_build(bvh_t *bvh, size_t start, size_t count) {
+  size_t index = bvh->num_nodes++;
+  bvh_node_t *node = &bvh->nodes[index];
+
+  node->box = bvh->entries[start].box;
+  aabb_t centers = {.min = {INFINITY, INFINITY},
+                    .max = {-INFINITY, -INFINITY}};
+  for (size_t i = start; i < start + count; i++) {
+    bvh_entry_t *entry = &bvh->entries[i];
+    node->box = aabb_union(node->box, entry->box);
+    vector_t center = {entry_center(entry, 0), entry_center(entry, 1)};
+    centers = aabb_union(centers, (aabb_t){.min = center, .max = center});
+  }
+
+  if (count <= BVH_LEAF_SIZE) {
+    node->start = start;
+    node->count = count;
+    return index;
+  }
+
+  // split at the median along the axis the centers are most spread over
+  int axis = centers.max.x - centers.min.x >= centers.max.y - centers.min.y
+                 ? 0
+                 : 1;
+  size_t half = count / 2;
+  select_nth(&bvh->entries[start], count, half, axis);
+  size_t left = bvh_build(bvh, start, half);
+  size_t right = bvh_build(bvh, start + half, count - half);
+
+  node = &bvh->nodes[index];
+  node->left = left;
+  node->right = right;
+  node->start = 0;
+  node->count = 0;
+  return index;
+}
+
+bvh_t *bvh_init(list_t *bodies) {
+  bvh_t *bvh = malloc(sizeof(bvh_t));
+  assert(bvh);
+  bvh->num_entries = list_size(bodies);
+  bvh->boxes = malloc(sizeof(aabb_t) * (bvh->num_entries + 1));
+  assert(bvh->boxes);
+  bvh->entries = malloc(sizeof(bvh_entry_t) * (bvh->num_entries + 1));
+  assert(bvh->entries);
+  // a binary tree with at least one entry per leaf
+  bvh->nodes = malloc(sizeof(bvh_node_t) * (2 * bvh->num_entries + 1));
+  assert(bvh->nodes);
+  bvh->num_nodes = 0;
+
+  for (size_t i = 0; i < bvh->num_entries; i++) {
+    body_t *body = list_get(bodies, i);
+    bvh->boxes[i] = aabb_from_body(body);
+    bvh->entries[i] =
+        (bvh_entry_t){.box = bvh->boxes[i], .body = body, .index = i};
+  }
+  if (bvh->num_entries > 0) {
+    bvh_build(bvh, 0, bvh->num_entries);
+  }
+  return bvh;
+}
+
+/**
+ * Finds when a box moving in a straight line first overlaps another box.
+ *
+ * @param target the box being swept against
+ * @param center the center of the moving box at the start of the sweep
+ * @param half the half extents of the moving box
+ * @param displacement the distance and direction the moving box travels
+ * @param limit the fraction of the sweep to search
+ * @param enter set to the fraction of the sweep at which the boxes first
+ * overlap, if they do
+ * @return whether the boxes overlap at some fraction between 0 and limit
+ */
+static bool sweep_box(aabb_t target, vector_t center, vector_t half,
+                      vector_t displacement, double limit, double *enter) {
+  double lo[2] = {target.min.x - half.x, target.min.y - half.y};
+  double hi[2] = {target.max.x + half.x, target.max.y + half.y};
+  double start[2] = {center.x, center.y};
+  double speed[2] = {displacement.x, displacement.y};
+  double t0 = 0;
+  double t1 = limit;
+
+  for (int axis = 0; axis < 2; axis++) {
+    if (speed[axis] == 0) {
+      if (start[axis] < lo[axis] || start[axis] > hi[axis]) {
+        return false;
+      }
+      continue;
+    }
+    double ta = (lo[axis] - start[axis]) / speed[axis];
+    double tb = (hi[axis] - start[axis]) / speed[axis];
+    t0 = fmax(t0, fmin(ta, tb));
+    t1 = fmin(t1, fmax(ta, tb));
+    if (t0 > t1) {
+      return false;
+    }
+  }
+  *enter = t0;
+  return true;
+}
+
+void bvh_sweep(bvh_t *bvh, aabb_t box, vector_t displacement,
+               bvh_sweep_callback_t callback, void *aux) {
+  if (bvh->num_nodes == 0) {
+    return;
+  }
+
+  vector_t center = vec_multiply(0.5, vec_add(box.min, box.max));
+  vector_t half = vec_multiply(0.5, vec_subtract(box.max, box.min));
+  double limit = 1;
+  double enter;
+
+  // nodes still to visit, with the fraction at which the sweep reaches them
+  size_t *stack = malloc(sizeof(size_t) * bvh->num_nodes);
+  double *stack_enter = malloc(sizeof(double) * bvh->num_nodes);
+  assert(stack);
+  assert(stack_enter);
+  size_t depth = 0;
+  if (sweep_box(bvh->nodes[0].box, center, half, displacement, limit,
+                &enter)) {
+    stack[depth] = 0;
+    stack_enter[depth] = enter;
+    depth++;
+  }
+
+  while (depth > 0) {
+    depth--;
+    if (stack_enter[depth] > limit) {
+      continue;
+    }
+    bvh_node_t *node = &bvh->nodes[stack[depth]];
+
+    if (node->count > 0) {
+      for (size_t i = node->start; i < node->start + node->count; i++) {
+        bvh_entry_t *entry = &bvh->entries[i];
+        if (sweep_box(entry->box, center, half, displacement, limit,
+                      &enter)) {
+          limit = fmin(limit, callback(entry->body, aux));
+        }
+      }
+      continue;
+    }
+
+    size_t children[2] = {node->left, node->right};
+    double child_enter[2];
+    bool child_hit[2];
+    for (int k = 0; k < 2; k++) {
+      child_hit[k] = sweep_box(bvh->nodes[children[k]].box, center, half,
+                               displacement, limit, &child_enter[k]);
+    }
+
+    // push the farther child first so the nearer one is visited first
+    int near =
+        child_hit[1] && (!child_hit[0] || child_enter[1] < child_enter[0]);
+    int order[2] = {1 - near, near};
+    for (int k = 0; k < 2; k++) {
+      if (child_hit[order[k]]) {
+        stack[depth] = children[order[k]];
+        stack_enter[depth] = child_enter[order[k]];
+        depth++;
+      }
+    }
+  }
+
+  free(stack);
+  free(stack_enter);
+}
+
+aabb_t bvh_get_box(bvh_t *bvh, size_t index) {
+  assert(index < bvh->num_entries);
+  return bvh->boxes[index];
+}
+
+/**
+ * Returns whether two boxes overlap, counting boxes that only touch.
+ */
+static bool aabb_overlap(aabb_t a, aabb_t b) {
+  return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y &&
+         b.min.y <= a.max.y;
+}
+
+void bvh_query(bvh_t *bvh, aabb_t box, bvh_query_callback_t callback,
+               void *aux) {
+  if (bvh->num_nodes == 0) {
+    return;
+  }
+
+  size_t *stack = malloc(sizeof(size_t) * bvh->num_nodes);
+  assert(stack);
+  size_t depth = 0;
+  stack[depth++] = 0;
+
+  while (depth > 0) {
+    bvh_node_t *node = &bvh->nodes[stack[--depth]];
+    if (!aabb_overlap(node->box, box)) {
+      continue;
+    }
+    if (node->count > 0) {
+      for (size_t i = node->start; i < node->start + node->count; i++) {
+        if (aabb_overlap(bvh->entries[i].box, box)) {
+          callback(bvh->entries[i].index, aux);
+        }
+      }
+    } else {
+      stack[depth++] = node->right;
+      stack[depth++] = node->left;
+    }
+  }
+
+  free(stack);
+}
+
+void bvh_free(bvh_t *bvh) {
+  free(bvh->boxes);
+  free(bvh->entries);
+  free(bvh->nodes);
+  free(bvh);
+}
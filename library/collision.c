@@ -1,121 +1,657 @@
 #include "collision.h"
 #include "body.h"
+#include "vector_batch.h"
 
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+
+const double TOUCH_DISTANCE = 1e-2;
 
 /**
- * Returns a list of vectors representing the edges of a shape.
- *
- * @param shape the list of vectors representing the vertices of a shape
- * @return a list of vectors representing the edges of the shape
+ * A convex polygon read from a body: views of its vertices and of the unit
+ * normals of its edges.
  */
-static list_t *get_edges(list_t *shape) {
-  list_t *edges = list_init(list_size(shape), free);
+typedef struct polygon {
+  shape_view_t vertices;
+  shape_view_t normals;
+} polygon_t;
 
-  for (size_t i = 0; i < list_size(shape); i++) {
-    vector_t *vec = malloc(sizeof(vector_t));
-    assert(vec);
-    *vec =
-        vec_subtract(*(vector_t *)list_get(shape, i % list_size(shape)),
-                     *(vector_t *)list_get(shape, (i + 1) % list_size(shape)));
-    list_add(edges, vec);
-  }
-
-  return edges;
+/**
+ * Reads the current polygon of a body without copying it.
+ *
+ * @param body the body to read
+ * @return the body's vertices and edge normals
+ */
+static polygon_t get_polygon(body_t *body) {
+  return (polygon_t){.vertices = body_get_shape_view(body),
+                     .normals = body_get_edge_normals(body)};
 }
 
 /**
  * Returns a vector containing the maximum and minimum length projections given
  * a unit axis and shape.
  *
- * @param shape the list of vectors representing the vertices of a shape
+ * @param shape the vertices of the shape
  * @param unit_axis the unit axis to project eeach vertex on
  * @return a vector in the form (max, min) where `max` is the maximum projection
  * length and `min` is the minimum projection length.
  */
-static vector_t get_max_min_projections(list_t *shape, vector_t unit_axis) {
-  double min = __DBL_MAX__;
-  double max = -__DBL_MAX__;
+static vector_t get_max_min_projections(shape_view_t shape,
+                                        vector_t unit_axis) {
+  return vec_batch_project(shape.vertices, shape.count, unit_axis);
+}
+
+/**
+ * Determines whether two convex polygons are separated along any edge normal
+ * of the first polygon, and finds the normal along which they overlap least.
+ * There is an edge between each pair of consecutive vertices,
+ * and one between the first vertex and the last vertex.
+ *
+ * @param polygon1 the polygon whose edge normals are tested
+ * @param shape2 the vertices of the other polygon
+ * @param min_overlap the least overlap seen so far, updated in place
+ * @param min_axis the unit axis of the least overlap, updated in place
+ * @return whether the shapes overlap, to within TOUCH_DISTANCE, along every
+ * edge normal of shape1
+ */
+static bool compare_collision(polygon_t polygon1, shape_view_t shape2,
+                              double *min_overlap, vector_t *min_axis) {
+  shape_view_t shape1 = polygon1.vertices;
+  for (size_t i = 0; i < polygon1.normals.count; i++) {
+    vector_t unit_axis = vec_from_sim(polygon1.normals.vertices[i]);
+    if (unit_axis.x == 0 && unit_axis.y == 0) {
+      continue;
+    }
 
-  for (size_t i = 0; i < list_size(shape); i++) {
-    double length = vec_dot(unit_axis, *(vector_t *)list_get(shape, i));
+    vector_t shape1_proj = get_max_min_projections(shape1, unit_axis);
+    vector_t shape2_proj = get_max_min_projections(shape2, unit_axis);
 
-    if (length > max) {
-      max = length;
+    double overlap = fmin(shape1_proj.x, shape2_proj.x) -
+                     fmax(shape1_proj.y, shape2_proj.y);
+    if (overlap < -TOUCH_DISTANCE) {
+      return false;
+    }
+    if (overlap < *min_overlap) {
+      *min_axis = unit_axis;
+      *min_overlap = overlap;
     }
+  }
+
+  return true;
+}
+
+/**
+ * Returns whether a polygon's vertices run counterclockwise (1)
+ * or clockwise (-1), from the sign of its area.
+ *
+ * @param shape the vertices of the polygon
+ * @return the orientation of the polygon
+ */
+static double get_orientation(shape_view_t shape) {
+  double area = 0;
+  for (size_t i = 0; i < shape.count; i++) {
+    area += vec_cross(vec_from_sim(shape.vertices[i]),
+                      vec_from_sim(shape.vertices[(i + 1) % shape.count]));
+  }
+  return area < 0 ? -1 : 1;
+}
 
-    if (length < min) {
-      min = length;
+/**
+ * Returns the edge of a polygon whose outward normal is closest to the given
+ * direction.
+ *
+ * @param polygon the polygon
+ * @param direction the direction to compare edge normals against
+ * @param alignment the dot product of that edge's normal and the direction
+ * @return the index of the edge's first vertex
+ */
+static size_t get_facing_edge(polygon_t polygon, vector_t direction,
+                              double *alignment) {
+  // flip the normals of clockwise polygons so they point outwards
+  double orientation = get_orientation(polygon.vertices);
+  size_t best = 0;
+  *alignment = -INFINITY;
+  for (size_t i = 0; i < polygon.normals.count; i++) {
+    double dot =
+        orientation *
+        vec_dot(vec_from_sim(polygon.normals.vertices[i]), direction);
+    if (dot > *alignment) {
+      *alignment = dot;
+      best = i;
     }
   }
+  return best;
+}
 
-  return (vector_t){.x = max, .y = min};
+/**
+ * Clips a segment to the half-plane of points p with dot(p, normal) <= offset.
+ *
+ * @param points the two ends of the segment, updated in place
+ * @param normal the normal of the clipping line
+ * @param offset the position of the clipping line along the normal
+ * @return whether any of the segment is left after clipping
+ */
+static bool clip_segment(vector_t points[2], vector_t normal, double offset) {
+  double d0 = vec_dot(points[0], normal) - offset;
+  double d1 = vec_dot(points[1], normal) - offset;
+  if (d0 > 0 && d1 > 0) {
+    return false;
+  }
+  if (d0 > 0 || d1 > 0) {
+    vector_t crossing = vec_add(
+        points[0],
+        vec_multiply(d0 / (d0 - d1), vec_subtract(points[1], points[0])));
+    points[d0 > 0 ? 0 : 1] = crossing;
+  }
+  return true;
 }
 
 /**
- * Determines whether two convex polygons intersect.
- * The polygons are given as lists of vertices in counterclockwise order.
- * There is an edge between each pair of consecutive vertices,
- * and one between the first vertex and the last vertex.
+ * Computes the contact points of two overlapping polygons by clipping the
+ * incident edge of one polygon against the reference edge of the other.
  *
- * @param shape1 the first shape
- * @param shape2 the second shape
- * @return whether the shapes are colliding
+ * @param polygon1 the first polygon
+ * @param polygon2 the second polygon
+ * @param manifold the manifold whose normal is already set;
+ * its contact points are filled in
  */
-static collision_info_t compare_collision(list_t *shape1, list_t *shape2,
-                                          double *min_overlap) {
-  list_t *edges1 = get_edges(shape1);
-  vector_t collision_axis = VEC_ZERO;
+static void find_contact_points(polygon_t polygon1, polygon_t polygon2,
+                                contact_manifold_t *manifold) {
+  vector_t normal = manifold->normal;
+  double align1, align2;
+  size_t edge1 = get_facing_edge(polygon1, normal, &align1);
+  size_t edge2 = get_facing_edge(polygon2, vec_negate(normal), &align2);
 
-  for (size_t i = 0; i < list_size(edges1); i++) {
-    vector_t *edge1 = list_get(edges1, i);
-    vector_t axis = vec_rotate(*edge1, M_PI / 2);
-    vector_t unit_axis = vec_multiply(1 / vec_get_length(axis), axis);
+  // the edge most perpendicular to the normal is the reference edge
+  shape_view_t ref = polygon1.vertices, inc = polygon2.vertices;
+  size_t ref_edge = edge1, inc_edge = edge2;
+  vector_t ref_normal = normal;
+  if (align2 > align1) {
+    ref = polygon2.vertices;
+    inc = polygon1.vertices;
+    ref_edge = edge2;
+    inc_edge = edge1;
+    ref_normal = vec_negate(normal);
+  }
 
-    vector_t shape1_proj = get_max_min_projections(shape1, unit_axis);
-    vector_t shape2_proj = get_max_min_projections(shape2, unit_axis);
+  vector_t ref_start = vec_from_sim(ref.vertices[ref_edge]);
+  vector_t ref_end = vec_from_sim(ref.vertices[(ref_edge + 1) % ref.count]);
+  vector_t points[2] = {vec_from_sim(inc.vertices[inc_edge]),
+                        vec_from_sim(inc.vertices[(inc_edge + 1) % inc.count])};
+
+  // keep the part of the incident edge alongside the reference edge
+  vector_t tangent = vec_subtract(ref_end, ref_start);
+  manifold->num_points = 0;
+  if (!clip_segment(points, vec_negate(tangent),
+                    -vec_dot(ref_start, tangent)) ||
+      !clip_segment(points, tangent, vec_dot(ref_end, tangent))) {
+    return;
+  }
 
-    if (shape1_proj.y > shape2_proj.x || shape2_proj.y > shape1_proj.x) {
-      list_free(edges1);
-      return (collision_info_t){.collided = false, .axis = VEC_ZERO};
+  // keep the points behind the reference edge
+  double ref_offset = vec_dot(ref_start, ref_normal);
+  for (size_t i = 0; i < 2; i++) {
+    if (vec_dot(points[i], ref_normal) <= ref_offset) {
+      manifold->points[manifold->num_points++] = points[i];
     }
+  }
+}
 
-    double overlap = vec_get_length(vec_subtract(shape2_proj, shape1_proj));
-    if (overlap < *min_overlap) {
-      collision_axis = unit_axis;
-      *min_overlap = overlap;
+collision_type_t collision_face(vector_t axis) {
+  if (-axis.y >= fabs(axis.x)) {
+    return UP_COLLISION;
+  }
+  if (axis.y >= fabs(axis.x)) {
+    return DOWN_COLLISION;
+  }
+  return axis.x > 0 ? LEFT_COLLISION : RIGHT_COLLISION;
+}
+
+collision_info_t find_collision_with_manifold(body_t *body1, body_t *body2,
+                                              contact_manifold_t *manifold) {
+  polygon_t polygon1 = get_polygon(body1);
+  polygon_t polygon2 = get_polygon(body2);
+
+  double depth = __DBL_MAX__;
+  vector_t axis = VEC_ZERO;
+  bool collided =
+      compare_collision(polygon1, polygon2.vertices, &depth, &axis) &&
+      compare_collision(polygon2, polygon1.vertices, &depth, &axis);
+
+  if (collided) {
+    vector_t offset =
+        vec_subtract(body_get_centroid(body2), body_get_centroid(body1));
+    if (vec_dot(axis, offset) < 0) {
+      axis = vec_negate(axis);
+    }
+    if (manifold != NULL) {
+      manifold->normal = axis;
+      manifold->depth = depth;
+      manifold->face = collision_face(axis);
+      find_contact_points(polygon1, polygon2, manifold);
     }
   }
 
-  list_free(edges1);
-  return (collision_info_t){.collided = true, .axis = collision_axis};
+  return (collision_info_t){.collided = collided,
+                            .axis = collided ? axis : VEC_ZERO};
 }
 
 collision_info_t find_collision(body_t *body1, body_t *body2) {
-  list_t *shape1 = body_get_shape(body1);
-  list_t *shape2 = body_get_shape(body2);
+  return find_collision_with_manifold(body1, body2, NULL);
+}
 
-  double c1_overlap = __DBL_MAX__;
-  double c2_overlap = __DBL_MAX__;
+bool find_overlap(body_t *body1, body_t *body2) {
+  // the bounding boxes reject most pairs before any edge normals are needed
+  aabb_t box1 = body_get_bounding_box(body1);
+  aabb_t box2 = body_get_bounding_box(body2);
+  double d = TOUCH_DISTANCE;
+  bool overlap = box1.min.x <= box2.max.x + d && box2.min.x <= box1.max.x + d &&
+                 box1.min.y <= box2.max.y + d && box2.min.y <= box1.max.y + d;
 
-  collision_info_t collision1 = compare_collision(shape1, shape2, &c1_overlap);
-  collision_info_t collision2 = compare_collision(shape2, shape1, &c2_overlap);
+  if (overlap) {
+    polygon_t polygon1 = get_polygon(body1);
+    polygon_t polygon2 = get_polygon(body2);
+    double depth = __DBL_MAX__;
+    vector_t axis = VEC_ZERO;
+    overlap = compare_collision(polygon1, polygon2.vertices, &depth, &axis) &&
+              compare_collision(polygon2, polygon1.vertices, &depth, &axis);
+  }
 
-  list_free(shape1);
-  list_free(shape2);
+  return overlap;
+}
 
-  if (!collision1.collided) {
-    return collision1;
+/**
+ * Narrows the interval of times during which a moving shape overlaps a static
+ * one, given their projections onto a single axis.
+ *
+ * @param mover_proj the mover's projection, in the form (max, min)
+ * @param obstacle_proj the obstacle's projection, in the form (max, min)
+ * @param speed the distance the mover travels along the axis
+ * @param enter the latest entry time seen so far, updated in place
+ * @param exit the earliest exit time seen so far, updated in place
+ * @return whether the entry time came from this axis
+ */
+static bool sweep_axis(vector_t mover_proj, vector_t obstacle_proj,
+                       double speed, double *enter, double *exit) {
+  // the shapes touch as soon as they meet, and until they are TOUCH_DISTANCE
+  // apart, as in find_collision()
+  if (speed == 0) {
+    if (mover_proj.x < obstacle_proj.y - TOUCH_DISTANCE ||
+        mover_proj.y > obstacle_proj.x + TOUCH_DISTANCE) {
+      *enter = INFINITY;
+    }
+    return false;
   }
 
-  if (!collision2.collided) {
-    return collision2;
+  double t0 = (obstacle_proj.y - mover_proj.x) / speed;
+  double t1 = (obstacle_proj.x - mover_proj.y) / speed;
+  if (t0 > t1) {
+    double temp = t0;
+    t0 = t1;
+    t1 = temp;
   }
+  t1 += TOUCH_DISTANCE / fabs(speed);
+  if (t1 < *exit) {
+    *exit = t1;
+  }
+  if (t0 > *enter) {
+    *enter = t0;
+    return true;
+  }
+  return false;
+}
 
-  if (c1_overlap < c2_overlap) {
-    return collision1;
+/**
+ * Sweeps a moving shape against a static one along the edge normals of one of
+ * the two shapes.
+ *
+ * @param edge_shape the shape whose edges give the axes to test
+ * @param mover the moving shape
+ * @param obstacle the static shape
+ * @param displacement the distance and direction the mover travels
+ * @param impact the impact being computed, updated in place
+ */
+static void sweep_edges(polygon_t edge_shape, shape_view_t mover,
+                        shape_view_t obstacle, vector_t displacement,
+                        impact_info_t *impact) {
+  for (size_t i = 0; i < edge_shape.normals.count; i++) {
+    vector_t unit_axis = vec_from_sim(edge_shape.normals.vertices[i]);
+    if (unit_axis.x == 0 && unit_axis.y == 0) {
+      continue;
+    }
+
+    double speed = vec_dot(unit_axis, displacement);
+    if (sweep_axis(get_max_min_projections(mover, unit_axis),
+                   get_max_min_projections(obstacle, unit_axis), speed,
+                   &impact->time, &impact->exit_time)) {
+      impact->axis = speed > 0 ? unit_axis : vec_negate(unit_axis);
+    }
   }
-  return collision2;
-}
\ No newline at end of file
+}
+
+impact_info_t find_time_of_impact(body_t *mover, vector_t displacement,
+                                  body_t *obstacle) {
+  polygon_t polygon1 = get_polygon(mover);
+  polygon_t polygon2 = get_polygon(obstacle);
+  shape_view_t shape1 = polygon1.vertices;
+  shape_view_t shape2 = polygon2.vertices;
+
+  impact_info_t impact = {
+      .hit = false, .time = -INFINITY, .exit_time = INFINITY, .axis = VEC_ZERO};
+  sweep_edges(polygon1, shape1, shape2, displacement, &impact);
+  sweep_edges(polygon2, shape1, shape2, displacement, &impact);
+
+  impact.hit = impact.time >= 0 && impact.time <= 1 &&
+               impact.time <= impact.exit_time;
+  return impact;
+}
+
+impact_info_t find_ray_impact(vector_t origin, vector_t displacement,
+                              body_t *obstacle) {
+  // a ray is a sweep of a single point, so only the obstacle has edges
+  sim_vector_t point_vertex = vec_to_sim(origin);
+  shape_view_t point = {.vertices = &point_vertex, .count = 1};
+  polygon_t polygon = get_polygon(obstacle);
+
+  impact_info_t impact = {
+      .hit = false, .time = -INFINITY, .exit_time = INFINITY, .axis = VEC_ZERO};
+  sweep_edges(polygon, point, polygon.vertices, displacement, &impact);
+
+  impact.hit = impact.time >= 0 && impact.time <= 1 &&
+               impact.time <= impact.exit_time;
+  return impact;
+}
+
+// One-vs-many narrowphase: SIMD lane helpers.
+// Every helper works on LANES doubles at a time; masks are all-ones lanes.
+// The lanes are doubles so that the batch finds the same overlaps as
+// find_collision(), down to bodies that exactly touch.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LANES 4
+typedef __m256d lane_t;
+static inline lane_t lane_load(const double *p) { return _mm256_loadu_pd(p); }
+static inline void lane_store(double *p, lane_t a) { _mm256_storeu_pd(p, a); }
+static inline lane_t lane_set(double f) { return _mm256_set1_pd(f); }
+static inline lane_t lane_add(lane_t a, lane_t b) {
+  return _mm256_add_pd(a, b);
+}
+static inline lane_t lane_sub(lane_t a, lane_t b) {
+  return _mm256_sub_pd(a, b);
+}
+static inline lane_t lane_mul(lane_t a, lane_t b) {
+  return _mm256_mul_pd(a, b);
+}
+static inline lane_t lane_min(lane_t a, lane_t b) {
+  return _mm256_min_pd(a, b);
+}
+static inline lane_t lane_max(lane_t a, lane_t b) {
+  return _mm256_max_pd(a, b);
+}
+static inline lane_t lane_lt(lane_t a, lane_t b) {
+  return _mm256_cmp_pd(a, b, _CMP_LT_OQ);
+}
+static inline lane_t lane_or(lane_t a, lane_t b) { return _mm256_or_pd(a, b); }
+static inline lane_t lane_select(lane_t mask, lane_t a, lane_t b) {
+  return _mm256_blendv_pd(b, a, mask);
+}
+static inline unsigned lane_bits(lane_t mask) {
+  return _mm256_movemask_pd(mask);
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LANES 2
+typedef __m128d lane_t;
+static inline lane_t lane_load(const double *p) { return _mm_loadu_pd(p); }
+static inline void lane_store(double *p, lane_t a) { _mm_storeu_pd(p, a); }
+static inline lane_t lane_set(double f) { return _mm_set1_pd(f); }
+static inline lane_t lane_add(lane_t a, lane_t b) { return _mm_add_pd(a, b); }
+static inline lane_t lane_sub(lane_t a, lane_t b) { return _mm_sub_pd(a, b); }
+static inline lane_t lane_mul(lane_t a, lane_t b) { return _mm_mul_pd(a, b); }
+static inline lane_t lane_min(lane_t a, lane_t b) { return _mm_min_pd(a, b); }
+static inline lane_t lane_max(lane_t a, lane_t b) { return _mm_max_pd(a, b); }
+static inline lane_t lane_lt(lane_t a, lane_t b) { return _mm_cmplt_pd(a, b); }
+static inline lane_t lane_or(lane_t a, lane_t b) { return _mm_or_pd(a, b); }
+static inline lane_t lane_select(lane_t mask, lane_t a, lane_t b) {
+  return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+static inline unsigned lane_bits(lane_t mask) { return _mm_movemask_pd(mask); }
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define LANES 2
+typedef v128_t lane_t;
+static inline lane_t lane_load(const double *p) { return wasm_v128_load(p); }
+static inline void lane_store(double *p, lane_t a) { wasm_v128_store(p, a); }
+static inline lane_t lane_set(double f) { return wasm_f64x2_splat(f); }
+static inline lane_t lane_add(lane_t a, lane_t b) {
+  return wasm_f64x2_add(a, b);
+}
+static inline lane_t lane_sub(lane_t a, lane_t b) {
+  return wasm_f64x2_sub(a, b);
+}
+static inline lane_t lane_mul(lane_t a, lane_t b) {
+  return wasm_f64x2_mul(a, b);
+}
+static inline lane_t lane_min(lane_t a, lane_t b) {
+  return wasm_f64x2_pmin(a, b);
+}
+static inline lane_t lane_max(lane_t a, lane_t b) {
+  return wasm_f64x2_pmax(a, b);
+}
+static inline lane_t lane_lt(lane_t a, lane_t b) { return wasm_f64x2_lt(a, b); }
+static inline lane_t lane_or(lane_t a, lane_t b) { return wasm_v128_or(a, b); }
+static inline lane_t lane_select(lane_t mask, lane_t a, lane_t b) {
+  return wasm_v128_bitselect(a, b, mask);
+}
+static inline unsigned lane_bits(lane_t mask) {
+  return wasm_i64x2_bitmask(mask);
+}
+#else
+#define LANES 1
+typedef double lane_t;
+static inline lane_t lane_load(const double *p) { return *p; }
+static inline void lane_store(double *p, lane_t a) { *p = a; }
+static inline lane_t lane_set(double f) { return f; }
+static inline lane_t lane_add(lane_t a, lane_t b) { return a + b; }
+static inline lane_t lane_sub(lane_t a, lane_t b) { return a - b; }
+static inline lane_t lane_mul(lane_t a, lane_t b) { return a * b; }
+static inline lane_t lane_min(lane_t a, lane_t b) { return a < b ? a : b; }
+static inline lane_t lane_max(lane_t a, lane_t b) { return a > b ? a : b; }
+static inline lane_t lane_lt(lane_t a, lane_t b) { return a < b ? -1.0 : 0.0; }
+static inline lane_t lane_or(lane_t a, lane_t b) {
+  return (a != 0.0 || b != 0.0) ? -1.0 : 0.0;
+}
+static inline lane_t lane_select(lane_t mask, lane_t a, lane_t b) {
+  return mask != 0.0 ? a : b;
+}
+static inline unsigned lane_bits(lane_t mask) { return mask != 0.0; }
+#endif
+
+struct box_batch {
+  size_t size;
+  size_t capacity;
+  double *min_x;
+  double *min_y;
+  double *max_x;
+  double *max_y;
+  body_t **bodies;
+};
+
+/**
+ * Rounds a box count up to a whole number of SIMD blocks.
+ */
+static size_t box_batch_padded(size_t n) {
+  return (n + LANES - 1) / LANES * LANES;
+}
+
+/**
+ * Grows the arrays of a batch to hold at least the given number of boxes.
+ * Padding lanes past the last box are zeroed; their results are ignored.
+ */
+static void box_batch_reserve(box_batch_t *batch, size_t capacity) {
+  size_t padded = box_batch_padded(capacity);
+  batch->min_x = realloc(batch->min_x, sizeof(double) * padded);
+  batch->min_y = realloc(batch->min_y, sizeof(double) * padded);
+  batch->max_x = realloc(batch->max_x, sizeof(double) * padded);
+  batch->max_y = realloc(batch->max_y, sizeof(double) * padded);
+  batch->bodies = realloc(batch->bodies, sizeof(body_t *) * padded);
+  assert(batch->min_x && batch->min_y && batch->max_x && batch->max_y &&
+         batch->bodies);
+  for (size_t i = batch->capacity; i < padded; i++) {
+    batch->min_x[i] = 0;
+    batch->min_y[i] = 0;
+    batch->max_x[i] = 0;
+    batch->max_y[i] = 0;
+    batch->bodies[i] = NULL;
+  }
+  batch->capacity = padded;
+}
+
+box_batch_t *box_batch_init(size_t initial_capacity) {
+  box_batch_t *batch = calloc(1, sizeof(box_batch_t));
+  assert(batch);
+  box_batch_reserve(batch, initial_capacity > 0 ? initial_capacity : 1);
+  return batch;
+}
+
+bool box_batch_fits(body_t *body) {
+  shape_view_t normals = body_get_edge_normals(body);
+  if (normals.count != 4) {
+    return false;
+  }
+  for (size_t i = 0; i < normals.count; i++) {
+    vector_t normal = vec_from_sim(normals.vertices[i]);
+    if (normal.x != 0 && normal.y != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void box_batch_add(box_batch_t *batch, body_t *body) {
+  if (batch->size == batch->capacity) {
+    box_batch_reserve(batch, batch->capacity * 2);
+  }
+  // read the box from the vertices themselves, which is what find_collision()
+  // projects
+  shape_view_t shape = body_get_shape_view(body);
+  vector_t x = get_max_min_projections(shape, (vector_t){.x = 1, .y = 0});
+  vector_t y = get_max_min_projections(shape, (vector_t){.x = 0, .y = 1});
+
+  size_t i = batch->size++;
+  batch->min_x[i] = x.y;
+  batch->min_y[i] = y.y;
+  batch->max_x[i] = x.x;
+  batch->max_y[i] = y.x;
+  batch->bodies[i] = body;
+}
+
+void box_batch_clear(box_batch_t *batch) { batch->size = 0; }
+
+size_t box_batch_size(box_batch_t *batch) { return batch->size; }
+
+body_t *box_batch_get_body(box_batch_t *batch, size_t index) {
+  assert(index < batch->size);
+  return batch->bodies[index];
+}
+
+void box_batch_free(box_batch_t *batch) {
+  free(batch->min_x);
+  free(batch->min_y);
+  free(batch->max_x);
+  free(batch->max_y);
+  free(batch->bodies);
+  free(batch);
+}
+
+size_t find_collision_batch(body_t *body, box_batch_t *batch, uint64_t *hits,
+                            vector_t *axes) {
+  polygon_t polygon = get_polygon(body);
+  shape_view_t shape = polygon.vertices;
+  size_t n = shape.count;
+
+  // Candidate axes: every edge normal of the shape, then the two box axes,
+  // which find_collision() would try in this order and direction for a box
+  // wound counterclockwise from its bottom left corner, so ties are broken
+  // the same way. The shape's projection onto each axis is the same for every
+  // box, so it is computed once up front.
+  size_t num_axes = n + 2;
+  vector_t *axis = malloc(sizeof(vector_t) * num_axes);
+  vector_t *proj = malloc(sizeof(vector_t) * num_axes);
+  assert(axis && proj);
+  size_t count_axes = 0;
+  for (size_t i = 0; i < n; i++) {
+    vector_t normal = vec_from_sim(polygon.normals.vertices[i]);
+    if (normal.x != 0 || normal.y != 0) {
+      axis[count_axes++] = normal;
+    }
+  }
+  axis[count_axes++] = (vector_t){.x = 0, .y = -1};
+  axis[count_axes++] = (vector_t){.x = 1, .y = 0};
+  num_axes = count_axes;
+  for (size_t i = 0; i < num_axes; i++) {
+    proj[i] = get_max_min_projections(shape, axis[i]);
+  }
+  vector_t centroid = body_get_centroid(body);
+
+  size_t count = batch->size;
+  memset(hits, 0, sizeof(uint64_t) * BOX_BATCH_MASK_WORDS(count));
+
+  size_t num_hits = 0;
+  double best_axis[LANES];
+  for (size_t base = 0; base < count; base += LANES) {
+    lane_t min_x = lane_load(&batch->min_x[base]);
+    lane_t min_y = lane_load(&batch->min_y[base]);
+    lane_t max_x = lane_load(&batch->max_x[base]);
+    lane_t max_y = lane_load(&batch->max_y[base]);
+
+    lane_t separated = lane_set(0);
+    lane_t best_depth = lane_set(__DBL_MAX__);
+    lane_t best_index = lane_set(0);
+    for (size_t k = 0; k < num_axes; k++) {
+      // a box's furthest corner along an axis is the furthest x plus the
+      // furthest y, exactly as if each corner were projected
+      lane_t nx = lane_set(axis[k].x), ny = lane_set(axis[k].y);
+      lane_t x1 = lane_mul(min_x, nx), x2 = lane_mul(max_x, nx);
+      lane_t y1 = lane_mul(min_y, ny), y2 = lane_mul(max_y, ny);
+      lane_t box_max = lane_add(lane_max(x1, x2), lane_max(y1, y2));
+      lane_t box_min = lane_add(lane_min(x1, x2), lane_min(y1, y2));
+      lane_t depth = lane_sub(lane_min(lane_set(proj[k].x), box_max),
+                              lane_max(lane_set(proj[k].y), box_min));
+
+      separated =
+          lane_or(separated, lane_lt(depth, lane_set(-TOUCH_DISTANCE)));
+      lane_t better = lane_lt(depth, best_depth);
+      best_depth = lane_select(better, depth, best_depth);
+      best_index = lane_select(better, lane_set(k), best_index);
+    }
+
+    unsigned hit_bits = ~lane_bits(separated) & ((1u << LANES) - 1);
+    if (hit_bits == 0) {
+      continue;
+    }
+    lane_store(best_axis, best_index);
+    for (size_t lane = 0; lane < LANES; lane++) {
+      size_t i = base + lane;
+      if (!(hit_bits & (1u << lane)) || i >= count) {
+        continue;
+      }
+      vector_t hit_axis = axis[(size_t)best_axis[lane]];
+      vector_t offset = {
+          .x = (batch->min_x[i] + batch->max_x[i]) / 2 - centroid.x,
+          .y = (batch->min_y[i] + batch->max_y[i]) / 2 - centroid.y};
+      if (vec_dot(hit_axis, offset) < 0) {
+        hit_axis = vec_negate(hit_axis);
+      }
+      axes[i] = hit_axis;
+      hits[i / 64] |= (uint64_t)1 << (i % 64);
+      num_hits++;
+    }
+  }
+
+  free(axis);
+  free(proj);
+  return num_hits;
+}
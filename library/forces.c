@@ -0,0 +1,230 @@
+#include "forces.h"
+#include "collision.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+// how close two bodies can get before gravity between them is ignored
+const double MIN_GRAVITY_DISTANCE = 5;
+// how many bodies a force creator acting on a pair of bodies pushes
+const size_t PAIR_BODIES = 2;
+
+typedef struct body_aux {
+  double force_const;
+  body_t *body1;
+  body_t *body2;
+} body_aux_t;
+
+typedef struct collision_aux {
+  collision_handler_t handler;
+  void *aux;
+  double force_const;
+  free_func_t freer;
+  body_t *body1;
+  body_t *body2;
+  // whether the bodies were colliding last tick
+  bool collided;
+} collision_aux_t;
+
+/**
+ * Allocates the auxiliary value of a force creator acting on up to two bodies.
+ *
+ * @param force_const the force creator's constant
+ * @param body1 the first body
+ * @param body2 the second body, or NULL
+ * @return the auxiliary value
+ */
+static body_aux_t *body_aux_init(double force_const, body_t *body1,
+                                 body_t *body2) {
+  body_aux_t *aux = malloc(sizeof(body_aux_t));
+  assert(aux);
+  aux->force_const = force_const;
+  aux->body1 = body1;
+  aux->body2 = body2;
+  return aux;
+}
+
+/**
+ * Makes the list of bodies a force creator acting on two bodies pushes.
+ *
+ * @param body1 the first body
+ * @param body2 the second body
+ * @return a list of the two bodies, which does not own them
+ */
+static list_t *pair_bodies(body_t *body1, body_t *body2) {
+  list_t *bodies = list_init(PAIR_BODIES, NULL);
+  list_add(bodies, body1);
+  list_add(bodies, body2);
+  return bodies;
+}
+
+/**
+ * Applies Newtonian gravity between two bodies.
+ *
+ * @param aux a body_aux_t holding G and the bodies
+ * @param bodies the bodies the force creator pushes
+ */
+static void newtonian_gravity(void *aux, list_t *bodies) {
+  body_aux_t *gravity = aux;
+  vector_t r = vec_subtract(body_get_centroid(gravity->body2),
+                            body_get_centroid(gravity->body1));
+  double distance = vec_get_length(r);
+  if (distance < MIN_GRAVITY_DISTANCE) {
+    return;
+  }
+  double magnitude = gravity->force_const * body_get_mass(gravity->body1) *
+                     body_get_mass(gravity->body2) / (distance * distance);
+  vector_t force = vec_multiply(magnitude / distance, r);
+  body_add_force(gravity->body1, force);
+  body_add_force(gravity->body2, vec_negate(force));
+}
+
+void create_newtonian_gravity(scene_t *scene, double G, body_t *body1,
+                              body_t *body2) {
+  scene_add_threaded_force_creator(scene, newtonian_gravity,
+                                   body_aux_init(G, body1, body2),
+                                   pair_bodies(body1, body2), free);
+}
+
+/**
+ * Applies a Hooke's-Law spring force between two bodies.
+ *
+ * @param aux a body_aux_t holding k and the bodies
+ * @param bodies the bodies the force creator pushes
+ */
+static void spring(void *aux, list_t *bodies) {
+  body_aux_t *spring = aux;
+  vector_t stretch = vec_subtract(body_get_centroid(spring->body2),
+                                  body_get_centroid(spring->body1));
+  vector_t force = vec_multiply(spring->force_const, stretch);
+  body_add_force(spring->body1, force);
+  body_add_force(spring->body2, vec_negate(force));
+}
+
+void create_spring(scene_t *scene, double k, body_t *body1, body_t *body2) {
+  scene_add_threaded_force_creator(scene, spring,
+                                   body_aux_init(k, body1, body2),
+                                   pair_bodies(body1, body2), free);
+}
+
+/**
+ * Applies a drag force proportional to a body's velocity.
+ *
+ * @param aux a body_aux_t holding gamma and the body
+ * @param bodies the body the force creator pushes
+ */
+static void drag(void *aux, list_t *bodies) {
+  body_aux_t *drag = aux;
+  vector_t force =
+      vec_multiply(-drag->force_const, body_get_velocity(drag->body1));
+  body_add_force(drag->body1, force);
+}
+
+void create_drag(scene_t *scene, double gamma, body_t *body) {
+  list_t *bodies = list_init(1, NULL);
+  list_add(bodies, body);
+  scene_add_threaded_force_creator(
+      scene, drag, body_aux_init(gamma, body, NULL), bodies, free);
+}
+
+/**
+ * Frees the auxiliary value of a collision force creator, along with the
+ * auxiliary value of its handler.
+ *
+ * @param aux a collision_aux_t
+ */
+static void collision_aux_free(void *aux) {
+  collision_aux_t *collision = aux;
+  if (collision->freer != NULL) {
+    collision->freer(collision->aux);
+  }
+  free(collision);
+}
+
+/**
+ * Calls a collision handler when two bodies start colliding.
+ *
+ * @param aux a collision_aux_t
+ * @param bodies the bodies the force creator acts on
+ */
+static void detect_collision(void *aux, list_t *bodies) {
+  collision_aux_t *collision = aux;
+  collision_info_t info = find_collision(collision->body1, collision->body2);
+  if (info.collided && !collision->collided) {
+    collision->handler(collision->body1, collision->body2, info.axis,
+                       collision->aux, collision->force_const);
+  }
+  collision->collided = info.collided;
+}
+
+void create_collision(scene_t *scene, body_t *body1, body_t *body2,
+                      collision_handler_t handler, void *aux,
+                      double force_const, free_func_t freer) {
+  collision_aux_t *collision = malloc(sizeof(collision_aux_t));
+  assert(collision);
+  *collision = (collision_aux_t){.handler = handler,
+                                 .aux = aux,
+                                 .force_const = force_const,
+                                 .freer = freer,
+                                 .body1 = body1,
+                                 .body2 = body2,
+                                 .collided = false};
+  scene_add_force_creator(scene, detect_collision, collision,
+                          pair_bodies(body1, body2), collision_aux_free);
+}
+
+/**
+ * Removes both bodies in a collision.
+ *
+ * @param body1 the first body
+ * @param body2 the second body
+ * @param axis the collision axis
+ * @param aux unused
+ * @param force_const unused
+ */
+static void destructive_collision(body_t *body1, body_t *body2, vector_t axis,
+                                  void *aux, double force_const) {
+  body_remove(body1);
+  body_remove(body2);
+}
+
+void create_destructive_collision(scene_t *scene, body_t *body1,
+                                  body_t *body2) {
+  create_collision(scene, body1, body2, destructive_collision, NULL, 0, NULL);
+}
+
+/**
+ * Applies the impulses that resolve a collision between two bodies.
+ *
+ * @param body1 the first body
+ * @param body2 the second body
+ * @param axis a unit vector pointing from body1 towards body2
+ * @param aux unused
+ * @param elasticity the coefficient of restitution
+ */
+static void physics_collision(body_t *body1, body_t *body2, vector_t axis,
+                              void *aux, double elasticity) {
+  double mass1 = body_get_mass(body1);
+  double mass2 = body_get_mass(body2);
+  double reduced_mass;
+  if (mass1 == INFINITY) {
+    reduced_mass = mass2;
+  } else if (mass2 == INFINITY) {
+    reduced_mass = mass1;
+  } else {
+    reduced_mass = mass1 * mass2 / (mass1 + mass2);
+  }
+  double u1 = vec_dot(body_get_velocity(body1), axis);
+  double u2 = vec_dot(body_get_velocity(body2), axis);
+  vector_t impulse =
+      vec_multiply(reduced_mass * (1 + elasticity) * (u2 - u1), axis);
+  body_add_impulse(body1, impulse);
+  body_add_impulse(body2, vec_negate(impulse));
+}
+
+void create_physics_collision(scene_t *scene, body_t *body1, body_t *body2,
+                              double elasticity) {
+  create_collision(scene, body1, body2, physics_collision, NULL, elasticity,
+                   NULL);
+}
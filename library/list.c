@@ -0,0 +1,63 @@
+#include "list.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+// how many times larger a full list's array becomes when it grows
+const size_t LIST_GROWTH_FACTOR = 2;
+
+struct list {
+  void **data;
+  size_t size;
+  size_t capacity;
+  free_func_t freer;
+};
+
+list_t *list_init(size_t initial_capacity, free_func_t freer) {
+  assert(initial_capacity > 0);
+  list_t *list = malloc(sizeof(list_t));
+  assert(list);
+  list->data = malloc(sizeof(void *) * initial_capacity);
+  assert(list->data);
+  list->size = 0;
+  list->capacity = initial_capacity;
+  list->freer = freer;
+  return list;
+}
+
+void list_free(list_t *list) {
+  if (list->freer != NULL) {
+    for (size_t i = 0; i < list->size; i++) {
+      list->freer(list->data[i]);
+    }
+  }
+  free(list->data);
+  free(list);
+}
+
+size_t list_size(list_t *list) { return list->size; }
+
+void *list_get(list_t *list, size_t index) {
+  assert(index < list->size);
+  return list->data[index];
+}
+
+void list_add(list_t *list, void *value) {
+  assert(value != NULL);
+  if (list->size == list->capacity) {
+    list->capacity *= LIST_GROWTH_FACTOR;
+    list->data = realloc(list->data, sizeof(void *) * list->capacity);
+    assert(list->data);
+  }
+  list->data[list->size++] = value;
+}
+
+void *list_remove(list_t *list, size_t index) {
+  assert(index < list->size);
+  void *value = list->data[index];
+  for (size_t i = index + 1; i < list->size; i++) {
+    list->data[i - 1] = list->data[i];
+  }
+  list->size--;
+  return value;
+}
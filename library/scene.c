@@ -0,0 +1,1943 @@
+#include "scene.h"
+#include "array.h"
+#include "bvh.h"
+#include "collision.h"
+#include "thread_pool.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+const size_t INIT_SIZE = 10;
+// the fewest candidate pairs worth spreading across threads
+const size_t PARALLEL_MIN_PAIRS = 64;
+// how many bodies' candidate pairs a thread tests before claiming more
+const size_t NARROWPHASE_CHUNK = 4;
+// the fewest boxes one body must be tested against to batch them
+const size_t MIN_BATCH_BOXES = 2;
+// the fewest groups of force creators worth spreading across threads
+const size_t PARALLEL_MIN_FORCE_GROUPS = 64;
+// how many groups of force creators a thread runs before claiming more
+const size_t FORCE_GROUP_CHUNK = 8;
+// the fewest bodies worth ticking on several threads
+const size_t PARALLEL_MIN_BODIES = 1024;
+// how many bodies a thread ticks before claiming more
+const size_t BODY_CHUNK = 128;
+// how many times a fast body can hit an obstacle and slide along it in a tick
+const size_t MAX_SLIDES = 3;
+
+typedef struct handler {
+  collision_handler_t collision_handler;
+  sensor_handler_t sensor_handler;
+  void *aux;
+  double force_const;
+  // the events the handler is called for, as SENSOR_EVENT_BIT()s
+  uint32_t events;
+  free_func_t freer;
+} handler_t;
+
+typedef struct contact {
+  body_t *body1;
+  body_t *body2;
+  size_t index1;
+  size_t index2;
+  vector_t axis;
+} contact_t;
+
+// a growable array of contacts; see ARRAY_DEFINE()
+ARRAY_DEFINE(contact_list, contact_t)
+
+/**
+ * The candidate pairs found by one body's broadphase search, which lie next
+ * to each other among the candidates.
+ */
+typedef struct search_run {
+  body_t *body;
+  size_t first;
+  size_t count;
+} search_run_t;
+
+// a growable array of search runs
+ARRAY_DEFINE(search_run_list, search_run_t)
+// a growable array of hit bitmask words
+ARRAY_DEFINE(mask_list, uint64_t)
+// a growable array of collision axes
+ARRAY_DEFINE(axis_list, vector_t)
+// a growable array of scene indices
+ARRAY_DEFINE(index_list, size_t)
+// a growable array of times, in seconds
+ARRAY_DEFINE(time_list, double)
+// a growable array of bodies, which it does not own
+ARRAY_DEFINE(body_list, body_t *)
+// a growable array of islands of sleeping bodies
+ARRAY_DEFINE(island_list, body_list_t)
+// a growable array of each kind's bodies, indexed by kind
+ARRAY_DEFINE(kind_list, body_list_t)
+// a growable array of body handles
+ARRAY_DEFINE(handle_list, body_handle_t)
+
+typedef struct force {
+  force_creator_t force_creator;
+  void *aux;
+  list_t *bodies;
+  free_func_t freer;
+  // whether the force creator may run off the thread calling scene_tick(); see
+  // scene_add_threaded_force_creator()
+  bool threaded;
+} force_t;
+
+// a growable array of force creators, which it owns
+ARRAY_DEFINE(force_list, force_t *)
+
+typedef struct body_pair {
+  body_t *body1;
+  body_t *body2;
+} body_pair_t;
+
+// a growable array of pairs of bodies
+ARRAY_DEFINE(body_pair_list, body_pair_t)
+
+/**
+ * A pair of bodies pushed by the same force creator,
+ * recorded along with the force creator's position in the scene.
+ */
+typedef struct force_link {
+  size_t force;
+  // the link's position among all the links of the tick, so that sorting by
+  // force creator keeps each force creator's links in order
+  size_t order;
+  body_pair_t pair;
+} force_link_t;
+
+// a growable array of force links
+ARRAY_DEFINE(force_link_list, force_link_t)
+
+/**
+ * A bounding volume hierarchy over some of a scene's bodies.
+ * The hierarchy reports positions in its own body list;
+ * indices maps them back to positions in the scene.
+ */
+typedef struct scene_tree {
+  bvh_t *bvh;
+  list_t *bodies;
+  index_list_t indices;
+} scene_tree_t;
+
+struct scene {
+  size_t num_bodies;
+  body_list_t bodies;
+  // the bodies of each kind, in the order they were added
+  kind_list_t kinds;
+  force_list_t force_creators;
+  // the force creators split into groups that push no bodies in common, as
+  // their positions in force_creators, group by group and in order within
+  // each group; group i is force_order[force_groups[i]] up to
+  // force_order[force_groups[i + 1]]. Rebuilt when force creators change.
+  index_list_t force_order;
+  index_list_t force_groups;
+  // the groups made only of threaded force creators come first, and number
+  // this many
+  size_t num_threaded_groups;
+  bool forces_grouped;
+  // handlers[i][j] holds the handlers for categories 1 << i and 1 << j
+  list_t *handlers[MAX_CATEGORIES][MAX_CATEGORIES];
+  // bit j of interacts[i] is set if any handler pairs categories i and j
+  uint32_t interacts[MAX_CATEGORIES];
+  // the events any handler is called for, so pairs that stay touching need
+  // no dispatch unless a handler asked for SENSOR_STAY
+  uint32_t handler_events;
+  // the pairs of bodies that were touching after the last dispatch, sorted
+  // with contact_compare()
+  contact_list_t contacts;
+  // static and sleeping bodies, rebuilt only when bodies are added or
+  // removed, or fall asleep or wake up
+  scene_tree_t static_tree;
+  // every other body, rebuilt after bodies move
+  scene_tree_t moving_tree;
+  // the non-static bodies that fast bodies are swept against, rebuilt when
+  // the moving bodies' hierarchy is
+  scene_tree_t pinned_tree;
+  // the number of threads to test pairs with, or 0 for one per processor
+  size_t num_workers;
+  // started the first time a pass has enough work to share out
+  thread_pool_t *pool;
+  // dynamic bodies slower than sleep_speed for sleep_time seconds fall asleep;
+  // sleep_speed is 0 if they never do
+  double sleep_speed;
+  double sleep_time;
+  // how long each body has been slower than sleep_speed, by scene index
+  time_list_t rest_times;
+  // groups of sleeping bodies, which wake up together
+  island_list_t islands;
+  // pairs of bodies pushed by the same force creator this tick
+  body_pair_list_t links;
+  // the bodies the last tick freed, in the order they were in the scene
+  handle_list_t removed;
+};
+
+/**
+ * Allocates memory for a force creator entry with the given parameters.
+ *
+ * @return a pointer to the newly allocated entry
+ */
+static force_t *force_init(force_creator_t force_creator, void *aux,
+                           list_t *bodies, free_func_t freer, bool threaded) {
+  force_t *force = malloc(sizeof(force_t));
+  assert(force);
+  force->force_creator = force_creator;
+  force->aux = aux;
+  force->bodies = bodies;
+  force->freer = freer;
+  force->threaded = threaded;
+  return force;
+}
+
+/**
+ * Frees a force creator entry, its auxiliary value and its body list.
+ *
+ * @param force the entry to free
+ */
+static void force_free(force_t *force) {
+  if (force->freer != NULL) {
+    force->freer(force->aux);
+  }
+  list_free(force->bodies);
+  free(force);
+}
+
+/**
+ * Frees a handler entry and its auxiliary value.
+ *
+ * @param handler the entry to free
+ */
+static void handler_free(handler_t *handler) {
+  if (handler->freer != NULL) {
+    handler->freer(handler->aux);
+  }
+  free(handler);
+}
+
+scene_t *scene_init(void) {
+  scene_t *scene = malloc(sizeof(scene_t));
+  assert(scene);
+  scene->num_bodies = 0;
+  scene->bodies = body_list_init(INIT_SIZE);
+  scene->kinds = kind_list_init(INIT_SIZE);
+  scene->force_creators = force_list_init(INIT_SIZE);
+  scene->force_order = index_list_init(INIT_SIZE);
+  scene->force_groups = index_list_init(INIT_SIZE);
+  scene->num_threaded_groups = 0;
+  scene->forces_grouped = false;
+  memset(scene->handlers, 0, sizeof(scene->handlers));
+  memset(scene->interacts, 0, sizeof(scene->interacts));
+  scene->handler_events = 0;
+  scene->contacts = contact_list_init(INIT_SIZE);
+  scene->static_tree = (scene_tree_t){.bvh = NULL};
+  scene->moving_tree = (scene_tree_t){.bvh = NULL};
+  scene->pinned_tree = (scene_tree_t){.bvh = NULL};
+  scene->num_workers = 0;
+  scene->pool = NULL;
+  scene->sleep_speed = 0;
+  scene->sleep_time = 0;
+  scene->rest_times = time_list_init(INIT_SIZE);
+  scene->islands = island_list_init(INIT_SIZE);
+  scene->links = body_pair_list_init(INIT_SIZE);
+  scene->removed = handle_list_init(INIT_SIZE);
+  return scene;
+}
+
+void scene_set_workers(scene_t *scene, size_t num_workers) {
+  if (scene->pool != NULL) {
+    thread_pool_free(scene->pool);
+    scene->pool = NULL;
+  }
+  scene->num_workers = num_workers;
+}
+
+void scene_set_sleeping(scene_t *scene, double speed, double time) {
+  assert(speed >= 0 && time >= 0);
+  if (speed == 0) {
+    // the islands are freed at the next tick
+    for (size_t i = 0; i < scene->islands.size; i++) {
+      body_list_t *island = &scene->islands.data[i];
+      for (size_t j = 0; j < island->size; j++) {
+        body_set_sleeping(island->data[j], false);
+      }
+    }
+  }
+  scene->sleep_speed = speed;
+  scene->sleep_time = time;
+}
+
+size_t scene_bodies(scene_t *scene) { return scene->num_bodies; }
+
+const body_handle_t *scene_get_removed(scene_t *scene, size_t *count) {
+  *count = scene->removed.size;
+  return scene->removed.data;
+}
+
+body_t *scene_get_body(scene_t *scene, size_t index) {
+  assert(index < scene->num_bodies);
+  return scene->bodies.data[index];
+}
+
+size_t scene_kind_bodies(scene_t *scene, body_kind_t kind) {
+  return kind < scene->kinds.size ? scene->kinds.data[kind].size : 0;
+}
+
+body_t *scene_get_kind_body(scene_t *scene, body_kind_t kind, size_t index) {
+  assert(index < scene_kind_bodies(scene, kind));
+  return scene->kinds.data[kind].data[index];
+}
+
+/**
+ * Discards a bounding volume hierarchy, so the next query rebuilds it.
+ *
+ * @param tree the hierarchy to discard
+ */
+static void scene_tree_invalidate(scene_tree_t *tree) {
+  if (tree->bvh != NULL) {
+    bvh_free(tree->bvh);
+    list_free(tree->bodies);
+    index_list_free(&tree->indices);
+    tree->bvh = NULL;
+  }
+}
+
+/**
+ * Returns whether a body stays still during a tick,
+ * i.e. it is static or asleep.
+ *
+ * @param body the body to check
+ * @return whether the body is kept in the scene's static hierarchy
+ */
+static bool scene_is_resting(body_t *body) {
+  return body_get_type(body) == BODY_STATIC || body_is_sleeping(body);
+}
+
+/**
+ * Returns whether a body can move during a tick.
+ *
+ * @param body the body to check
+ * @return whether the body is kept in the scene's moving hierarchy
+ */
+static bool scene_is_moving(body_t *body) { return !scene_is_resting(body); }
+
+/**
+ * Builds a bounding volume hierarchy over the bodies in a scene that satisfy
+ * a predicate, if it is not already built.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param tree the hierarchy to build
+ * @param member returns whether a body belongs in the hierarchy
+ */
+static void scene_tree_build(scene_t *scene, scene_tree_t *tree,
+                             bool (*member)(body_t *body)) {
+  if (tree->bvh != NULL) {
+    return;
+  }
+  tree->bodies = list_init(INIT_SIZE, NULL);
+  tree->indices = index_list_init(INIT_SIZE);
+  for (size_t i = 0; i < scene->num_bodies; i++) {
+    body_t *body = scene->bodies.data[i];
+    if (member(body)) {
+      list_add(tree->bodies, body);
+      index_list_add(&tree->indices, i);
+    }
+  }
+  tree->bvh = bvh_init(tree->bodies);
+}
+
+/**
+ * Discards the scene's bounding volume hierarchies, so the next query
+ * rebuilds them from the bodies' current positions.
+ * The hierarchy over resting bodies is kept unless all is true,
+ * since they do not move.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param all whether to also discard the hierarchy over resting bodies
+ */
+static void scene_invalidate_bvh(scene_t *scene, bool all) {
+  scene_tree_invalidate(&scene->moving_tree);
+  scene_tree_invalidate(&scene->pinned_tree);
+  if (all) {
+    scene_tree_invalidate(&scene->static_tree);
+  }
+}
+
+void scene_add_body(scene_t *scene, body_t *body) {
+  body_list_add(&scene->bodies, body);
+  scene->num_bodies++;
+  body_kind_t kind = body_get_kind(body);
+  while (scene->kinds.size <= kind) {
+    kind_list_add(&scene->kinds, body_list_init(INIT_SIZE));
+  }
+  body_list_add(&scene->kinds.data[kind], body);
+  time_list_add(&scene->rest_times, 0);
+  scene_invalidate_bvh(scene, scene_is_resting(body));
+}
+
+void scene_remove_body(scene_t *scene, size_t index) {
+  assert(index < scene->num_bodies);
+  body_remove(scene->bodies.data[index]);
+}
+
+void scene_add_force_creator(scene_t *scene, force_creator_t force_creator,
+                             void *aux, list_t *bodies, free_func_t freer) {
+  force_list_add(&scene->force_creators,
+                 force_init(force_creator, aux, bodies, freer, false));
+  scene->forces_grouped = false;
+}
+
+void scene_add_threaded_force_creator(scene_t *scene,
+                                      force_creator_t force_creator, void *aux,
+                                      list_t *bodies, free_func_t freer) {
+  force_list_add(&scene->force_creators,
+                 force_init(force_creator, aux, bodies, freer, true));
+  scene->forces_grouped = false;
+}
+
+/**
+ * Frees every force creator that acts on a body marked for removal,
+ * in a single pass that keeps the others in order.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ */
+static void scene_remove_force_creators(scene_t *scene) {
+  force_list_t *forces = &scene->force_creators;
+  size_t kept = 0;
+  for (size_t i = 0; i < forces->size; i++) {
+    force_t *force = forces->data[i];
+    bool acts_on_removed = false;
+    for (size_t j = 0; j < list_size(force->bodies); j++) {
+      if (body_is_removed(list_get(force->bodies, j))) {
+        acts_on_removed = true;
+        break;
+      }
+    }
+    if (acts_on_removed) {
+      force_free(force);
+      scene->forces_grouped = false;
+    } else {
+      forces->data[kept++] = force;
+    }
+  }
+  forces->size = kept;
+}
+
+/**
+ * Returns the index of the single bit set in a category.
+ * Asserts that exactly one bit is set.
+ *
+ * @param category a category bit
+ * @return the position of the bit
+ */
+static size_t category_index(uint32_t category) {
+  assert(category != 0 && (category & (category - 1)) == 0);
+  size_t index = 0;
+  while (!(category & ((uint32_t)1 << index))) {
+    index++;
+  }
+  return index;
+}
+
+/**
+ * Adds a handler to the dispatch table.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param category1 the category of the first body passed to the handler
+ * @param category2 the category of the second body passed to the handler
+ * @param handler the handler entry, which the scene takes ownership of
+ */
+static void scene_add_handler(scene_t *scene, uint32_t category1,
+                              uint32_t category2, handler_t *handler) {
+  size_t i = category_index(category1);
+  size_t j = category_index(category2);
+  if (scene->handlers[i][j] == NULL) {
+    scene->handlers[i][j] = list_init(1, (free_func_t)handler_free);
+  }
+  list_add(scene->handlers[i][j], handler);
+  scene->interacts[i] |= category2;
+  scene->interacts[j] |= category1;
+  scene->handler_events |= handler->events;
+}
+
+void scene_add_collision_handler(scene_t *scene, uint32_t category1,
+                                 uint32_t category2,
+                                 collision_handler_t handler, void *aux,
+                                 double force_const, free_func_t freer) {
+  handler_t *entry = malloc(sizeof(handler_t));
+  assert(entry);
+  *entry = (handler_t){.collision_handler = handler,
+                       .sensor_handler = NULL,
+                       .aux = aux,
+                       .force_const = force_const,
+                       .events = SENSOR_EVENT_BIT(SENSOR_ENTER),
+                       .freer = freer};
+  scene_add_handler(scene, category1, category2, entry);
+}
+
+void scene_add_sensor_handler(scene_t *scene, uint32_t sensor_category,
+                              uint32_t body_category, sensor_handler_t handler,
+                              uint32_t events, void *aux, free_func_t freer) {
+  handler_t *entry = malloc(sizeof(handler_t));
+  assert(entry);
+  *entry = (handler_t){.collision_handler = NULL,
+                       .sensor_handler = handler,
+                       .aux = aux,
+                       .force_const = 0,
+                       .events = events,
+                       .freer = freer};
+  scene_add_handler(scene, sensor_category, body_category, entry);
+}
+
+/**
+ * Returns whether any handler applies to a pair of bodies,
+ * and their masks let them touch.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param body1 the first body
+ * @param body2 the second body
+ * @return whether the scene should check if the bodies touch
+ */
+static bool scene_pair_has_handler(scene_t *scene, body_t *body1,
+                                   body_t *body2) {
+  uint32_t category1 = body_get_category(body1);
+  uint32_t category2 = body_get_category(body2);
+  if (!(category1 & body_get_mask(body2)) ||
+      !(category2 & body_get_mask(body1))) {
+    return false;
+  }
+  for (size_t i = 0; i < MAX_CATEGORIES; i++) {
+    if ((category1 & ((uint32_t)1 << i)) && (scene->interacts[i] & category2)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Calls the handlers in one cell of the dispatch table.
+ *
+ * @param handlers the handlers for the categories of body1 and body2,
+ * or NULL if there are none
+ * @param body1 the first body to pass to the handlers
+ * @param body2 the second body to pass to the handlers
+ * @param axis a unit vector pointing from body1 towards body2
+ * @param event whether the bodies started touching, are still touching,
+ * or stopped touching
+ * @param sensor whether either body is a sensor, which only sensor handlers
+ * are told about
+ */
+static void scene_call_handlers(list_t *handlers, body_t *body1, body_t *body2,
+                                vector_t axis, sensor_event_t event,
+                                bool sensor) {
+  if (handlers == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < list_size(handlers); i++) {
+    handler_t *handler = list_get(handlers, i);
+    if (!(handler->events & SENSOR_EVENT_BIT(event))) {
+      continue;
+    }
+    if (handler->collision_handler != NULL && !sensor) {
+      handler->collision_handler(body1, body2, axis, handler->aux,
+                                 handler->force_const);
+    }
+    if (handler->sensor_handler != NULL) {
+      handler->sensor_handler(body1, body2, event, handler->aux);
+    }
+  }
+}
+
+/**
+ * Calls every handler registered for the categories of a pair of bodies,
+ * in whichever order the handler was registered with.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param contact the pair of bodies
+ * @param event whether the bodies started touching, are still touching,
+ * or stopped touching
+ */
+static void scene_dispatch(scene_t *scene, contact_t *contact,
+                           sensor_event_t event) {
+  uint32_t category1 = body_get_category(contact->body1);
+  uint32_t category2 = body_get_category(contact->body2);
+  bool sensor =
+      body_is_sensor(contact->body1) || body_is_sensor(contact->body2);
+  for (size_t i = 0; i < MAX_CATEGORIES; i++) {
+    if (!(category1 & ((uint32_t)1 << i))) {
+      continue;
+    }
+    for (size_t j = 0; j < MAX_CATEGORIES; j++) {
+      if (!(category2 & ((uint32_t)1 << j))) {
+        continue;
+      }
+      scene_call_handlers(scene->handlers[i][j], contact->body1,
+                          contact->body2, contact->axis, event, sensor);
+      if (i != j) {
+        scene_call_handlers(scene->handlers[j][i], contact->body2,
+                            contact->body1, vec_negate(contact->axis), event,
+                            sensor);
+      }
+    }
+  }
+}
+
+/**
+ * Orders contacts by the scene indices of their bodies.
+ */
+static int contact_compare(const void *a, const void *b) {
+  const contact_t *contact1 = a;
+  const contact_t *contact2 = b;
+  if (contact1->index1 != contact2->index1) {
+    return contact1->index1 < contact2->index1 ? -1 : 1;
+  }
+  if (contact1->index2 != contact2->index2) {
+    return contact1->index2 < contact2->index2 ? -1 : 1;
+  }
+  return 0;
+}
+
+typedef struct broadphase {
+  scene_t *scene;
+  size_t index;
+  scene_tree_t *tree;
+  contact_list_t candidates;
+} broadphase_t;
+
+/**
+ * Records a candidate pair found by the broadphase if it has a handler.
+ *
+ * @param position the position of the second body in the hierarchy searched
+ * @param broadphase the broadphase pass, including the first body's index
+ */
+static void scene_add_candidate(size_t position, broadphase_t *broadphase) {
+  scene_t *scene = broadphase->scene;
+  size_t index = broadphase->tree->indices.data[position];
+  // resting bodies never search, so a pair is only found twice if both bodies
+  // move; then only keep it from its first body
+  if (broadphase->tree == &scene->moving_tree && index <= broadphase->index) {
+    return;
+  }
+  size_t index1 = broadphase->index < index ? broadphase->index : index;
+  size_t index2 = broadphase->index < index ? index : broadphase->index;
+  body_t *body1 = scene->bodies.data[index1];
+  body_t *body2 = scene->bodies.data[index2];
+  if (body_is_removed(body1) || body_is_removed(body2) ||
+      !scene_pair_has_handler(scene, body1, body2)) {
+    return;
+  }
+  contact_list_add(&broadphase->candidates,
+                   (contact_t){.body1 = body1,
+                               .body2 = body2,
+                               .index1 = index1,
+                               .index2 = index2,
+                               .axis = VEC_ZERO});
+}
+
+/**
+ * Gets how many threads to spread a pass over, starting the scene's threads
+ * the first time a pass has enough work to share out.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param count how many items the pass works through
+ * @param min_count the fewest items worth spreading across threads
+ * @return the number of workers to use, or 1 to run the pass on this thread
+ */
+static size_t scene_pass_workers(scene_t *scene, size_t count,
+                                 size_t min_count) {
+  if (count < min_count || scene->num_workers == 1) {
+    return 1;
+  }
+  if (scene->pool == NULL) {
+    scene->pool = thread_pool_init(scene->num_workers);
+  }
+  return thread_pool_workers(scene->pool);
+}
+
+/**
+ * The scratch space of one worker in the narrowphase.
+ */
+typedef struct narrowphase_worker {
+  // the touching pairs the worker has found
+  contact_list_t contacts;
+  // the boxes a body is being tested against together, and the position of
+  // each one's pair in the candidates
+  box_batch_t *boxes;
+  index_list_t pairs;
+  mask_list_t hits;
+  axis_list_t axes;
+} narrowphase_worker_t;
+
+typedef struct narrowphase {
+  contact_list_t *candidates;
+  search_run_list_t *runs;
+  // one per worker, so workers never share one
+  narrowphase_worker_t *workers;
+} narrowphase_t;
+
+/**
+ * Checks whether the bodies of one candidate pair touch,
+ * and records them as a contact in the worker's own array if they do.
+ * Sensor pairs only need to know whether they overlap, so their contacts
+ * have no axis.
+ *
+ * @param contact the candidate pair
+ * @param worker the worker checking the pair
+ */
+static void scene_check_pair(contact_t contact, narrowphase_worker_t *worker) {
+  if (body_is_sensor(contact.body1) || body_is_sensor(contact.body2)) {
+    if (find_overlap(contact.body1, contact.body2)) {
+      contact_list_add(&worker->contacts, contact);
+    }
+    return;
+  }
+  collision_info_t collision = find_collision(contact.body1, contact.body2);
+  if (collision.collided) {
+    contact.axis = collision.axis;
+    contact_list_add(&worker->contacts, contact);
+  }
+}
+
+/**
+ * Checks the candidate pairs one body's search found. Solid axis-aligned
+ * boxes are tested against the body together with find_collision_batch(),
+ * and any other pair on its own.
+ * Runs on any of the scene's worker threads.
+ *
+ * @param index the position of the search in the narrowphase's runs
+ * @param worker_index the worker checking the pairs
+ * @param narrowphase the narrowphase pass
+ */
+static void scene_check_run(size_t index, size_t worker_index,
+                            narrowphase_t *narrowphase) {
+  search_run_t run = narrowphase->runs->data[index];
+  narrowphase_worker_t *worker = &narrowphase->workers[worker_index];
+  contact_t *candidates = &narrowphase->candidates->data[run.first];
+  box_batch_clear(worker->boxes);
+  index_list_clear(&worker->pairs);
+  bool sensor = body_is_sensor(run.body);
+  for (size_t i = 0; i < run.count; i++) {
+    contact_t contact = candidates[i];
+    body_t *other = contact.body1 == run.body ? contact.body2 : contact.body1;
+    if (!sensor && !body_is_sensor(other) && box_batch_fits(other)) {
+      box_batch_add(worker->boxes, other);
+      index_list_add(&worker->pairs, i);
+    } else {
+      scene_check_pair(contact, worker);
+    }
+  }
+
+  size_t num_boxes = box_batch_size(worker->boxes);
+  if (num_boxes < MIN_BATCH_BOXES) {
+    for (size_t i = 0; i < num_boxes; i++) {
+      scene_check_pair(candidates[worker->pairs.data[i]], worker);
+    }
+    return;
+  }
+  mask_list_reserve(&worker->hits, BOX_BATCH_MASK_WORDS(num_boxes));
+  axis_list_reserve(&worker->axes, num_boxes);
+  if (find_collision_batch(run.body, worker->boxes, worker->hits.data,
+                           worker->axes.data) == 0) {
+    return;
+  }
+  for (size_t i = 0; i < num_boxes; i++) {
+    if (!(worker->hits.data[i / 64] & ((uint64_t)1 << (i % 64)))) {
+      continue;
+    }
+    contact_t contact = candidates[worker->pairs.data[i]];
+    // the batch's axes point from the searching body to the box
+    vector_t axis = worker->axes.data[i];
+    contact.axis = contact.body1 == run.body ? axis : vec_negate(axis);
+    contact_list_add(&worker->contacts, contact);
+  }
+}
+
+/**
+ * Checks every candidate pair, spreading the bodies that searched for them
+ * across the scene's worker threads if there are enough pairs to be worth it.
+ * The result does not depend on how many threads are used.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param candidates the pairs found by the broadphase
+ * @param runs the pairs each body's search found
+ * @return the pairs that touch, sorted by their bodies' indices in the scene
+ */
+static contact_list_t scene_narrowphase(scene_t *scene,
+                                        contact_list_t *candidates,
+                                        search_run_list_t *runs) {
+  size_t num_workers =
+      scene_pass_workers(scene, candidates->size, PARALLEL_MIN_PAIRS);
+
+  narrowphase_worker_t *workers =
+      malloc(sizeof(narrowphase_worker_t) * num_workers);
+  assert(workers);
+  for (size_t i = 0; i < num_workers; i++) {
+    workers[i] =
+        (narrowphase_worker_t){.contacts = contact_list_init(INIT_SIZE),
+                               .boxes = box_batch_init(INIT_SIZE),
+                               .pairs = index_list_init(INIT_SIZE),
+                               .hits = mask_list_init(1),
+                               .axes = axis_list_init(INIT_SIZE)};
+  }
+  narrowphase_t narrowphase = {
+      .candidates = candidates, .runs = runs, .workers = workers};
+  if (num_workers == 1) {
+    for (size_t i = 0; i < runs->size; i++) {
+      scene_check_run(i, 0, &narrowphase);
+    }
+  } else {
+    // bodies update their cached geometry when it is read, so read it here
+    // first, rather than from several threads at once
+    for (size_t i = 0; i < candidates->size; i++) {
+      body_get_shape_view(candidates->data[i].body1);
+      body_get_edge_normals(candidates->data[i].body1);
+      body_get_shape_view(candidates->data[i].body2);
+      body_get_edge_normals(candidates->data[i].body2);
+    }
+    thread_pool_for(scene->pool, runs->size, NARROWPHASE_CHUNK,
+                    (thread_pool_task_t)scene_check_run, &narrowphase);
+  }
+
+  // which worker found a contact varies, so sort after merging
+  contact_list_t merged = workers[0].contacts;
+  for (size_t i = 1; i < num_workers; i++) {
+    for (size_t j = 0; j < workers[i].contacts.size; j++) {
+      contact_list_add(&merged, workers[i].contacts.data[j]);
+    }
+    contact_list_free(&workers[i].contacts);
+  }
+  for (size_t i = 0; i < num_workers; i++) {
+    box_batch_free(workers[i].boxes);
+    index_list_free(&workers[i].pairs);
+    mask_list_free(&workers[i].hits);
+    axis_list_free(&workers[i].axes);
+  }
+  free(workers);
+  qsort(merged.data, merged.size, sizeof(contact_t), contact_compare);
+  return merged;
+}
+
+/**
+ * Returns whether a body touching a sleeping body should wake it up,
+ * i.e. it is awake and can push it.
+ *
+ * @param body the body touching a sleeping body
+ * @return whether the sleeping body should wake
+ */
+static bool scene_wakes(body_t *body) {
+  if (body_is_sleeping(body) || body_is_sensor(body)) {
+    return false;
+  }
+  vector_t velocity = body_get_velocity(body);
+  return body_get_type(body) == BODY_DYNAMIC ||
+         (body_get_type(body) == BODY_KINEMATIC &&
+          (velocity.x != 0 || velocity.y != 0));
+}
+
+/**
+ * Wakes a sleeping body in a pair that touch if the other body can push it.
+ * The rest of its island wakes up at the next scene_wake_islands().
+ *
+ * @param contact the pair of bodies
+ */
+static void scene_wake_contact(contact_t *contact) {
+  if (body_is_sensor(contact->body1) || body_is_sensor(contact->body2)) {
+    return;
+  }
+  if (body_is_sleeping(contact->body1) && scene_wakes(contact->body2)) {
+    body_set_sleeping(contact->body1, false);
+  } else if (body_is_sleeping(contact->body2) && scene_wakes(contact->body1)) {
+    body_set_sleeping(contact->body2, false);
+  }
+}
+
+/**
+ * Finds every pair of bodies that touch and have a handler, in one pass over
+ * the scene's bounding volume hierarchy, then calls the handlers.
+ * Pairs are checked in parallel, but dispatched on the calling thread in
+ * order of their bodies' indices in the scene.
+ * Pairs that stopped touching since the last dispatch are reported to their
+ * sensor handlers. Pairs of resting bodies are assumed to still touch.
+ * Sleeping bodies touched by a body that can push them are woken.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ */
+static void scene_dispatch_contacts(scene_t *scene) {
+  scene_tree_build(scene, &scene->static_tree, scene_is_resting);
+  scene_tree_build(scene, &scene->moving_tree, scene_is_moving);
+
+  // only moving bodies search, since two resting bodies never need checking
+  broadphase_t broadphase = {
+      .scene = scene, .index = 0, .candidates = contact_list_init(INIT_SIZE)};
+  search_run_list_t runs = search_run_list_init(INIT_SIZE);
+  scene_tree_t *moving = &scene->moving_tree;
+  for (size_t i = 0; i < moving->indices.size; i++) {
+    body_t *body = list_get(moving->bodies, i);
+    if (body_get_category(body) == 0 || body_is_removed(body)) {
+      continue;
+    }
+    size_t first = broadphase.candidates.size;
+    broadphase.index = moving->indices.data[i];
+    // bodies a hair apart still collide; see TOUCH_DISTANCE
+    aabb_t box = bvh_get_box(moving->bvh, i);
+    box.min = vec_subtract(box.min, (vector_t){TOUCH_DISTANCE, TOUCH_DISTANCE});
+    box.max = vec_add(box.max, (vector_t){TOUCH_DISTANCE, TOUCH_DISTANCE});
+    broadphase.tree = moving;
+    bvh_query(moving->bvh, box, (bvh_query_callback_t)scene_add_candidate,
+              &broadphase);
+    broadphase.tree = &scene->static_tree;
+    bvh_query(scene->static_tree.bvh, box,
+              (bvh_query_callback_t)scene_add_candidate, &broadphase);
+    if (broadphase.candidates.size > first) {
+      search_run_list_add(
+          &runs, (search_run_t){.body = body,
+                                .first = first,
+                                .count = broadphase.candidates.size - first});
+    }
+  }
+
+  contact_list_t previous = scene->contacts;
+  scene->contacts = scene_narrowphase(scene, &broadphase.candidates, &runs);
+  contact_list_free(&broadphase.candidates);
+  search_run_list_free(&runs);
+  contact_list_t *contacts = &scene->contacts;
+
+  // pairs of resting bodies were not checked, so still touch if they did
+  size_t num_found = contacts->size;
+  for (size_t i = 0; i < previous.size; i++) {
+    contact_t contact = previous.data[i];
+    if (scene_is_resting(contact.body1) && scene_is_resting(contact.body2) &&
+        !body_is_removed(contact.body1) && !body_is_removed(contact.body2)) {
+      contact_list_add(contacts, contact);
+    }
+  }
+  if (contacts->size > num_found) {
+    qsort(contacts->data, contacts->size, sizeof(contact_t), contact_compare);
+  }
+  for (size_t i = 0; i < contacts->size; i++) {
+    scene_wake_contact(&contacts->data[i]);
+  }
+
+  // both lists are sorted, so one pass over them finds the pairs in both;
+  // handlers may remove bodies, but they are not freed until the tick ends
+  contact_list_t exited = contact_list_init(INIT_SIZE);
+  size_t next = 0;
+  for (size_t i = 0; i < contacts->size; i++) {
+    contact_t contact = contacts->data[i];
+    while (next < previous.size &&
+           contact_compare(&previous.data[next], &contact) < 0) {
+      contact_list_add(&exited, previous.data[next++]);
+    }
+    bool stayed = next < previous.size &&
+                  contact_compare(&previous.data[next], &contact) == 0;
+    if (stayed) {
+      next++;
+      if (!(scene->handler_events & SENSOR_EVENT_BIT(SENSOR_STAY))) {
+        continue;
+      }
+    }
+    scene_dispatch(scene, &contact, stayed ? SENSOR_STAY : SENSOR_ENTER);
+  }
+  for (; next < previous.size; next++) {
+    contact_list_add(&exited, previous.data[next]);
+  }
+  for (size_t i = 0; i < exited.size; i++) {
+    scene_dispatch(scene, &exited.data[i], SENSOR_EXIT);
+  }
+  contact_list_free(&exited);
+  contact_list_free(&previous);
+}
+
+/**
+ * Orders scene indices from smallest to largest.
+ */
+static int index_compare(const void *a, const void *b) {
+  size_t index1 = *(const size_t *)a, index2 = *(const size_t *)b;
+  return index1 < index2 ? -1 : index1 > index2;
+}
+
+/**
+ * Finds where a body ends up in the scene once some bodies are freed.
+ *
+ * @param removed the indices of the bodies being freed, in increasing order
+ * @param index the body's index before they are freed
+ * @return the body's index afterwards, or SIZE_MAX if it is being freed
+ */
+static size_t scene_index_after_removal(const index_list_t *removed,
+                                        size_t index) {
+  // count the freed bodies before this one
+  size_t low = 0, high = removed->size;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (removed->data[mid] < index) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low < removed->size && removed->data[low] == index) {
+    return SIZE_MAX;
+  }
+  return index - low;
+}
+
+/**
+ * Drops every contact involving a body that is about to be freed,
+ * reporting it to the pair's sensor handlers, and moves the others to the
+ * bodies' new indices.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param removed the indices of the bodies being freed, in increasing order
+ */
+static void scene_remove_contacts(scene_t *scene,
+                                  const index_list_t *removed) {
+  contact_list_t *contacts = &scene->contacts;
+  size_t kept = 0;
+  for (size_t i = 0; i < contacts->size; i++) {
+    contact_t contact = contacts->data[i];
+    size_t index1 = scene_index_after_removal(removed, contact.index1);
+    size_t index2 = scene_index_after_removal(removed, contact.index2);
+    if (index1 == SIZE_MAX || index2 == SIZE_MAX) {
+      scene_dispatch(scene, &contact, SENSOR_EXIT);
+    } else {
+      contact.index1 = index1;
+      contact.index2 = index2;
+      contacts->data[kept++] = contact;
+    }
+  }
+  contacts->size = kept;
+}
+
+/**
+ * Drops the bodies marked for removal from the list of one kind's bodies.
+ *
+ * @param kind the bodies of the kind
+ */
+static void scene_remove_kind_bodies(body_list_t *kind) {
+  size_t kept = 0;
+  for (size_t i = 0; i < kind->size; i++) {
+    if (!body_is_removed(kind->data[i])) {
+      kind->data[kept++] = kind->data[i];
+    }
+  }
+  kind->size = kept;
+}
+
+/**
+ * Frees the bodies marked for removal, along with their force creators and
+ * contacts, and records their handles for scene_get_removed(). The other
+ * bodies keep their order, moving down to fill the gaps; only the bodies after
+ * the first one freed move, and only the kinds of the freed bodies are
+ * compacted.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param removed the indices of the bodies marked for removal, in increasing
+ * order
+ */
+static void scene_remove_bodies(scene_t *scene, const index_list_t *removed) {
+  body_list_t freed = body_list_init(removed->size);
+  index_list_t kinds = index_list_init(removed->size);
+  size_t kept = removed->data[0];
+  for (size_t i = 0; i < removed->size; i++) {
+    body_t *body = scene->bodies.data[removed->data[i]];
+    body_list_add(&freed, body);
+    index_list_add(&kinds, body_get_kind(body));
+    handle_list_add(&scene->removed, body_get_handle(body));
+    size_t end =
+        i + 1 < removed->size ? removed->data[i + 1] : scene->num_bodies;
+    for (size_t j = removed->data[i] + 1; j < end; j++) {
+      scene->bodies.data[kept] = scene->bodies.data[j];
+      scene->rest_times.data[kept] = scene->rest_times.data[j];
+      kept++;
+    }
+  }
+  scene->bodies.size = kept;
+  scene->rest_times.size = kept;
+  scene->num_bodies = kept;
+  qsort(kinds.data, kinds.size, sizeof(size_t), index_compare);
+  for (size_t i = 0; i < kinds.size; i++) {
+    if (i == 0 || kinds.data[i] != kinds.data[i - 1]) {
+      scene_remove_kind_bodies(&scene->kinds.data[kinds.data[i]]);
+    }
+  }
+
+  // the handlers told about the removed bodies can still read them
+  scene_remove_contacts(scene, removed);
+  scene_remove_force_creators(scene);
+  for (size_t i = 0; i < freed.size; i++) {
+    body_free(freed.data[i]);
+  }
+  body_list_free(&freed);
+  index_list_free(&kinds);
+  // later bodies have shifted down, and some may have been static
+  scene_invalidate_bvh(scene, true);
+}
+
+/**
+ * Returns whether a body is static geometry for continuous collision
+ * detection, i.e. it is a static body, or has infinite mass and is not moving.
+ *
+ * @param body the body to check
+ * @return whether fast bodies should be swept against the body
+ */
+static bool scene_is_static(body_t *body) {
+  vector_t velocity = body_get_velocity(body);
+  bool at_rest = body_get_type(body) == BODY_STATIC ||
+                 (body_get_mass(body) >= __DBL_MAX__ && velocity.x == 0 &&
+                  velocity.y == 0);
+  return at_rest && !body_is_removed(body) && !body_is_sensor(body);
+}
+
+/**
+ * Returns whether a body that can move is static geometry for continuous
+ * collision detection. The others are in the scene's resting hierarchy.
+ *
+ * @param body the body to check
+ * @return whether the body is kept in the scene's pinned hierarchy
+ */
+static bool scene_is_pinned(body_t *body) {
+  return scene_is_moving(body) && scene_is_static(body);
+}
+
+typedef struct swept_body {
+  body_t *body;
+  vector_t displacement;
+  double time;
+  // the axis of the earliest hit, pointing from the body to the obstacle
+  vector_t axis;
+} swept_body_t;
+
+/**
+ * Finds when a fast body first hits an obstacle,
+ * keeping the earliest hit found so far.
+ *
+ * @param obstacle a body the fast body may hit
+ * @param swept the fast body and its motion this tick
+ * @return the fraction of the motion still to search
+ */
+static double scene_sweep_obstacle(body_t *obstacle, swept_body_t *swept) {
+  if (obstacle == swept->body || !scene_is_static(obstacle)) {
+    return swept->time;
+  }
+  impact_info_t impact =
+      find_time_of_impact(swept->body, swept->displacement, obstacle);
+  if (impact.hit && impact.exit_time < 1 && impact.time < swept->time) {
+    swept->time = impact.time;
+    swept->axis = impact.axis;
+  }
+  return swept->time;
+}
+
+/**
+ * Ticks a fast body, then sweeps it from its old position to its new one.
+ * If it would pass straight through a static body on the way, it stops where
+ * it first touches that body, loses its velocity into the body, and slides
+ * the rest of the way along it. Static bodies it still overlaps at the end of
+ * the tick are left to the collision force creators.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param body the fast body to tick
+ * @param dt the time elapsed since the last tick, in seconds
+ */
+static void scene_tick_swept(scene_t *scene, body_t *body, double dt) {
+  vector_t position = body_get_centroid(body);
+  body_tick(body, dt);
+  vector_t displacement = vec_subtract(body_get_centroid(body), position);
+  if (displacement.x == 0 && displacement.y == 0) {
+    return;
+  }
+
+  scene_tree_build(scene, &scene->static_tree, scene_is_resting);
+  scene_tree_build(scene, &scene->pinned_tree, scene_is_pinned);
+  for (size_t i = 0; i < MAX_SLIDES; i++) {
+    body_set_centroid(body, position);
+    swept_body_t swept = {
+        .body = body, .displacement = displacement, .time = 1};
+    bvh_sweep(scene->static_tree.bvh, body_get_bounding_box(body),
+              displacement, (bvh_sweep_callback_t)scene_sweep_obstacle,
+              &swept);
+    bvh_sweep(scene->pinned_tree.bvh, body_get_bounding_box(body),
+              displacement, (bvh_sweep_callback_t)scene_sweep_obstacle,
+              &swept);
+    position = vec_add(position, vec_multiply(swept.time, displacement));
+    if (swept.time >= 1) {
+      break;
+    }
+
+    vector_t velocity = body_get_velocity(body);
+    double into = vec_dot(velocity, swept.axis);
+    if (into > 0) {
+      body_set_velocity(
+          body, vec_subtract(velocity, vec_multiply(into, swept.axis)));
+    }
+    vector_t rest = vec_multiply(1 - swept.time, displacement);
+    displacement = vec_subtract(
+        rest, vec_multiply(vec_dot(rest, swept.axis), swept.axis));
+    if (displacement.x == 0 && displacement.y == 0) {
+      break;
+    }
+  }
+  body_set_centroid(body, position);
+}
+
+/**
+ * Returns whether every body a force creator acts on is resting,
+ * and at least one of them is asleep, so it need not run.
+ *
+ * @param force the force creator
+ * @return whether the force creator's bodies are asleep
+ */
+static bool scene_force_is_asleep(force_t *force) {
+  bool sleeping = false;
+  for (size_t i = 0; i < list_size(force->bodies); i++) {
+    body_t *body = list_get(force->bodies, i);
+    if (!scene_is_resting(body)) {
+      return false;
+    }
+    sleeping = sleeping || body_is_sleeping(body);
+  }
+  return sleeping;
+}
+
+/**
+ * Runs a force creator, and links the bodies it pushed into one island,
+ * so they fall asleep and wake up together.
+ *
+ * @param force the force creator
+ * @param index the force creator's position in the scene
+ * @param links the array to record the links in
+ */
+static void scene_apply_force(force_t *force, size_t index,
+                              force_link_list_t *links) {
+  list_t *bodies = force->bodies;
+  size_t num_bodies = list_size(bodies);
+  // the force and impulse on each body before the force creator runs
+  vector_array_t pushes = vector_array_init(2 * num_bodies);
+  for (size_t i = 0; i < num_bodies; i++) {
+    body_t *body = list_get(bodies, i);
+    vector_array_add(&pushes, body_get_force(body));
+    vector_array_add(&pushes, body_get_impulse(body));
+  }
+  force->force_creator(force->aux, bodies);
+
+  body_t *first = NULL;
+  for (size_t i = 0; i < num_bodies; i++) {
+    body_t *body = list_get(bodies, i);
+    vector_t force_before = pushes.data[2 * i];
+    vector_t impulse_before = pushes.data[2 * i + 1];
+    vector_t force_after = body_get_force(body);
+    vector_t impulse_after = body_get_impulse(body);
+    if (force_after.x == force_before.x && force_after.y == force_before.y &&
+        impulse_after.x == impulse_before.x &&
+        impulse_after.y == impulse_before.y) {
+      continue;
+    }
+    if (first == NULL) {
+      first = body;
+    } else {
+      force_link_list_add(
+          links, (force_link_t){.force = index,
+                                .pair = {.body1 = first, .body2 = body}});
+    }
+  }
+  vector_array_free(&pushes);
+}
+
+/**
+ * Finds the root of a body's group in a union-find forest over body slots,
+ * shortening the path to it on the way.
+ *
+ * @param parents the next slot towards the root of each slot's group
+ * @param slot the slot of the body
+ * @return the slot at the root
+ */
+static size_t force_group_find(size_t *parents, size_t slot) {
+  while (parents[slot] != slot) {
+    parents[slot] = parents[parents[slot]];
+    slot = parents[slot];
+  }
+  return slot;
+}
+
+/**
+ * Splits the scene's force creators into groups that push no bodies in
+ * common, so that the groups can run at the same time.
+ * Force creators that share a body, even through other force creators, are
+ * in the same group, in the order they were added. The groups whose force
+ * creators are all threaded come first.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ */
+static void scene_group_forces(scene_t *scene) {
+  force_list_t *forces = &scene->force_creators;
+  size_t num_slots = 1;
+  for (size_t i = 0; i < forces->size; i++) {
+    list_t *bodies = forces->data[i]->bodies;
+    for (size_t j = 0; j < list_size(bodies); j++) {
+      size_t slot = body_get_handle(list_get(bodies, j)).slot;
+      num_slots = slot + 1 > num_slots ? slot + 1 : num_slots;
+    }
+  }
+
+  // join the bodies of each force creator into one group
+  size_t *parents = malloc(sizeof(size_t) * num_slots);
+  assert(parents);
+  for (size_t i = 0; i < num_slots; i++) {
+    parents[i] = i;
+  }
+  for (size_t i = 0; i < forces->size; i++) {
+    list_t *bodies = forces->data[i]->bodies;
+    for (size_t j = 1; j < list_size(bodies); j++) {
+      size_t root1 =
+          force_group_find(parents, body_get_handle(list_get(bodies, 0)).slot);
+      size_t root2 =
+          force_group_find(parents, body_get_handle(list_get(bodies, j)).slot);
+      parents[root2] = root1;
+    }
+  }
+
+  // number the groups in the order of their first force creators
+  index_list_t groups = index_list_init(forces->size);
+  size_t num_groups = 0;
+  size_t *root_groups = malloc(sizeof(size_t) * num_slots);
+  assert(root_groups);
+  for (size_t i = 0; i < num_slots; i++) {
+    root_groups[i] = SIZE_MAX;
+  }
+  for (size_t i = 0; i < forces->size; i++) {
+    list_t *bodies = forces->data[i]->bodies;
+    if (list_size(bodies) == 0) {
+      index_list_add(&groups, num_groups++);
+      continue;
+    }
+    size_t root =
+        force_group_find(parents, body_get_handle(list_get(bodies, 0)).slot);
+    if (root_groups[root] == SIZE_MAX) {
+      root_groups[root] = num_groups++;
+    }
+    index_list_add(&groups, root_groups[root]);
+  }
+  free(parents);
+  free(root_groups);
+
+  // renumber the groups so the threaded ones come first, each in the order of
+  // their first force creators; each group starts as 1 if all of its force
+  // creators are threaded and 0 otherwise
+  index_list_t renumbered = index_list_init(num_groups);
+  renumbered.size = num_groups;
+  for (size_t i = 0; i < num_groups; i++) {
+    renumbered.data[i] = 1;
+  }
+  for (size_t i = 0; i < groups.size; i++) {
+    if (!forces->data[i]->threaded) {
+      renumbered.data[groups.data[i]] = 0;
+    }
+  }
+  size_t num_threaded = 0;
+  for (size_t i = 0; i < num_groups; i++) {
+    num_threaded += renumbered.data[i];
+  }
+  size_t next_threaded = 0;
+  size_t next_main = num_threaded;
+  for (size_t i = 0; i < num_groups; i++) {
+    renumbered.data[i] = renumbered.data[i] ? next_threaded++ : next_main++;
+  }
+  for (size_t i = 0; i < groups.size; i++) {
+    groups.data[i] = renumbered.data[groups.data[i]];
+  }
+  index_list_free(&renumbered);
+  scene->num_threaded_groups = num_threaded;
+
+  // sort the force creators by group, keeping their order within each group
+  index_list_t *starts = &scene->force_groups;
+  index_list_clear(starts);
+  for (size_t i = 0; i <= num_groups; i++) {
+    index_list_add(starts, 0);
+  }
+  for (size_t i = 0; i < groups.size; i++) {
+    starts->data[groups.data[i] + 1]++;
+  }
+  for (size_t i = 1; i <= num_groups; i++) {
+    starts->data[i] += starts->data[i - 1];
+  }
+  index_list_t *order = &scene->force_order;
+  index_list_clear(order);
+  index_list_reserve(order, forces->size);
+  order->size = forces->size;
+  index_list_t next = index_list_from(starts->data, num_groups + 1);
+  for (size_t i = 0; i < groups.size; i++) {
+    order->data[next.data[groups.data[i]]++] = i;
+  }
+  index_list_free(&next);
+  index_list_free(&groups);
+  scene->forces_grouped = true;
+}
+
+typedef struct force_pass {
+  scene_t *scene;
+  bool sleeping;
+  // one array of links per worker, so workers never share one
+  force_link_list_t *links;
+} force_pass_t;
+
+/**
+ * Runs one of the force creators, skipping it if its bodies are asleep.
+ *
+ * @param pass the force pass
+ * @param index the force creator's position in the scene
+ * @param worker the worker running it
+ */
+static void scene_run_force(force_pass_t *pass, size_t index, size_t worker) {
+  force_t *force = pass->scene->force_creators.data[index];
+  if (!pass->sleeping) {
+    force->force_creator(force->aux, force->bodies);
+  } else if (!scene_force_is_asleep(force)) {
+    scene_apply_force(force, index, &pass->links[worker]);
+  }
+}
+
+/**
+ * Runs the force creators of one group, in order.
+ * Runs on any of the scene's worker threads if the group is threaded.
+ *
+ * @param group the position of the group
+ * @param worker the worker running the group
+ * @param pass the force pass
+ */
+static void scene_run_force_group(size_t group, size_t worker,
+                                  force_pass_t *pass) {
+  scene_t *scene = pass->scene;
+  size_t end = scene->force_groups.data[group + 1];
+  for (size_t i = scene->force_groups.data[group]; i < end; i++) {
+    scene_run_force(pass, scene->force_order.data[i], worker);
+  }
+}
+
+/**
+ * Orders force links by their force creators' positions in the scene,
+ * then by the order they were recorded in.
+ */
+static int force_link_compare(const void *a, const void *b) {
+  const force_link_t *link1 = a, *link2 = b;
+  if (link1->force != link2->force) {
+    return link1->force < link2->force ? -1 : 1;
+  }
+  return link1->order < link2->order ? -1 : link1->order > link2->order;
+}
+
+/**
+ * Runs every force creator, spreading groups of threaded ones that push no
+ * bodies in common across the scene's worker threads if there are enough.
+ * The other groups run on this thread once the workers have finished, so
+ * handlers called by force creators never run alongside them.
+ * Each body is pushed by the same force creators in the same order however
+ * many threads are used, so the forces on it are added up the same way.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ */
+static void scene_run_forces(scene_t *scene) {
+  if (!scene->forces_grouped) {
+    scene_group_forces(scene);
+  }
+  size_t num_groups = scene->force_groups.size - 1;
+  size_t num_threaded = scene->num_threaded_groups;
+  size_t num_workers =
+      scene_pass_workers(scene, num_threaded, PARALLEL_MIN_FORCE_GROUPS);
+
+  force_link_list_t *links = malloc(sizeof(force_link_list_t) * num_workers);
+  assert(links);
+  for (size_t i = 0; i < num_workers; i++) {
+    links[i] = force_link_list_init(INIT_SIZE);
+  }
+  force_pass_t pass = {.scene = scene,
+                       .sleeping = scene->sleep_speed > 0,
+                       .links = links};
+  if (num_workers == 1) {
+    for (size_t i = 0; i < scene->force_creators.size; i++) {
+      scene_run_force(&pass, i, 0);
+    }
+  } else {
+    thread_pool_for(scene->pool, num_threaded, FORCE_GROUP_CHUNK,
+                    (thread_pool_task_t)scene_run_force_group, &pass);
+    for (size_t i = num_threaded; i < num_groups; i++) {
+      scene_run_force_group(i, 0, &pass);
+    }
+  }
+
+  // which worker ran a force creator varies, so sort after merging
+  force_link_list_t merged = links[0];
+  for (size_t i = 1; i < num_workers; i++) {
+    for (size_t j = 0; j < links[i].size; j++) {
+      force_link_list_add(&merged, links[i].data[j]);
+    }
+    force_link_list_free(&links[i]);
+  }
+  free(links);
+  for (size_t i = 0; i < merged.size; i++) {
+    merged.data[i].order = i;
+  }
+  qsort(merged.data, merged.size, sizeof(force_link_t), force_link_compare);
+  for (size_t i = 0; i < merged.size; i++) {
+    body_pair_list_add(&scene->links, merged.data[i].pair);
+  }
+  force_link_list_free(&merged);
+}
+
+/**
+ * Wakes every island of sleeping bodies that has a body awake or removed.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ */
+static void scene_wake_islands(scene_t *scene) {
+  island_list_t *islands = &scene->islands;
+  size_t i = 0;
+  while (i < islands->size) {
+    body_list_t *island = &islands->data[i];
+    bool awake = false;
+    for (size_t j = 0; j < island->size && !awake; j++) {
+      body_t *body = island->data[j];
+      awake = !body_is_sleeping(body) || body_is_removed(body);
+    }
+    if (!awake) {
+      i++;
+      continue;
+    }
+    for (size_t j = 0; j < island->size; j++) {
+      body_set_sleeping(island->data[j], false);
+    }
+    body_list_free(island);
+    islands->data[i] = islands->data[--islands->size];
+    // the woken bodies move from one hierarchy to the other
+    scene_invalidate_bvh(scene, true);
+  }
+}
+
+typedef struct island_node {
+  body_t *body;
+  size_t index;
+  // the next node towards the root of the node's island
+  size_t parent;
+  // for a root, whether any body in its island has not rested long enough
+  bool restless;
+  // for a root, where its island is in the scene's islands, if it sleeps
+  size_t island;
+} island_node_t;
+
+// a growable array of island nodes
+ARRAY_DEFINE(island_node_list, island_node_t)
+
+/**
+ * Orders island nodes by the addresses of their bodies.
+ */
+static int island_node_compare(const void *a, const void *b) {
+  uintptr_t body1 = (uintptr_t)((const island_node_t *)a)->body;
+  uintptr_t body2 = (uintptr_t)((const island_node_t *)b)->body;
+  return body1 < body2 ? -1 : body1 > body2;
+}
+
+/**
+ * Finds the root of a node's island, shortening the path to it on the way.
+ *
+ * @param nodes the nodes, sorted by island_node_compare()
+ * @param index the position of the node
+ * @return the position of the root
+ */
+static size_t island_find(island_node_t *nodes, size_t index) {
+  while (nodes[index].parent != index) {
+    nodes[index].parent = nodes[nodes[index].parent].parent;
+    index = nodes[index].parent;
+  }
+  return index;
+}
+
+/**
+ * Joins the islands of two bodies, if both are awake and dynamic.
+ *
+ * @param nodes the nodes, sorted by island_node_compare()
+ * @param body1 the first body
+ * @param body2 the second body
+ */
+static void island_link(island_node_list_t *nodes, body_t *body1,
+                        body_t *body2) {
+  island_node_t key1 = {.body = body1}, key2 = {.body = body2};
+  island_node_t *node1 = bsearch(&key1, nodes->data, nodes->size,
+                                 sizeof(island_node_t), island_node_compare);
+  island_node_t *node2 = bsearch(&key2, nodes->data, nodes->size,
+                                 sizeof(island_node_t), island_node_compare);
+  if (node1 == NULL || node2 == NULL) {
+    return;
+  }
+  size_t root1 = island_find(nodes->data, node1 - nodes->data);
+  size_t root2 = island_find(nodes->data, node2 - nodes->data);
+  if (root1 != root2) {
+    nodes->data[root2].parent = root1;
+    nodes->data[root1].restless |= nodes->data[root2].restless;
+  }
+}
+
+/**
+ * Groups the awake dynamic bodies into islands of bodies that touch or were
+ * pushed by the same force creator this tick, and puts every island whose
+ * bodies have all rested for long enough to sleep.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ */
+static void scene_sleep_islands(scene_t *scene) {
+  island_node_list_t nodes = island_node_list_init(INIT_SIZE);
+  for (size_t i = 0; i < scene->num_bodies; i++) {
+    body_t *body = scene->bodies.data[i];
+    if (body_get_type(body) == BODY_DYNAMIC && !body_is_sleeping(body)) {
+      island_node_list_add(
+          &nodes,
+          (island_node_t){.body = body,
+                          .index = i,
+                          .restless = scene->rest_times.data[i] <
+                                      scene->sleep_time,
+                          .island = SIZE_MAX});
+    }
+  }
+  qsort(nodes.data, nodes.size, sizeof(island_node_t), island_node_compare);
+  for (size_t i = 0; i < nodes.size; i++) {
+    nodes.data[i].parent = i;
+  }
+
+  for (size_t i = 0; i < scene->contacts.size; i++) {
+    contact_t *contact = &scene->contacts.data[i];
+    if (!body_is_sensor(contact->body1) && !body_is_sensor(contact->body2)) {
+      island_link(&nodes, contact->body1, contact->body2);
+    }
+  }
+  for (size_t i = 0; i < scene->links.size; i++) {
+    island_link(&nodes, scene->links.data[i].body1,
+                scene->links.data[i].body2);
+  }
+  body_pair_list_clear(&scene->links);
+
+  island_list_t *islands = &scene->islands;
+  for (size_t i = 0; i < nodes.size; i++) {
+    island_node_t *root = &nodes.data[island_find(nodes.data, i)];
+    if (root->restless) {
+      continue;
+    }
+    if (root->island == SIZE_MAX) {
+      root->island = islands->size;
+      island_list_add(islands, body_list_init(INIT_SIZE));
+      // the sleeping bodies move from one hierarchy to the other
+      scene_invalidate_bvh(scene, true);
+    }
+    body_list_add(&islands->data[root->island], nodes.data[i].body);
+    body_set_sleeping(nodes.data[i].body, true);
+    scene->rest_times.data[nodes.data[i].index] = 0;
+  }
+  island_node_list_free(&nodes);
+}
+
+/**
+ * Updates how long a body has been slower than the scene's sleep speed,
+ * after it has moved.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param index the index of the body in the scene
+ * @param dt the time elapsed since the last tick, in seconds
+ */
+static void scene_update_rest_time(scene_t *scene, size_t index, double dt) {
+  double speed = vec_get_length(body_get_velocity(scene->bodies.data[index]));
+  double *rest_time = &scene->rest_times.data[index];
+  *rest_time = speed < scene->sleep_speed ? *rest_time + dt : 0;
+}
+
+typedef struct integration {
+  scene_t *scene;
+  double dt;
+  // for each worker, the fast bodies it found, as indices in the scene
+  index_list_t *fast;
+  // for each worker, the bodies marked for removal it found, as indices in
+  // the scene
+  index_list_t *removed;
+} integration_t;
+
+/**
+ * Ticks one body, unless it is resting, removed or fast.
+ * Runs on any of the scene's worker threads; body_tick() only changes the
+ * body it ticks.
+ *
+ * @param index the index of the body in the scene
+ * @param worker the worker ticking the body
+ * @param integration the integration pass
+ */
+static void scene_integrate_body(size_t index, size_t worker,
+                                 integration_t *integration) {
+  scene_t *scene = integration->scene;
+  body_t *body = scene->bodies.data[index];
+  if (body_is_removed(body)) {
+    index_list_add(&integration->removed[worker], index);
+  } else if (body_is_fast(body) && !scene_is_resting(body)) {
+    index_list_add(&integration->fast[worker], index);
+  } else if (!scene_is_resting(body)) {
+    body_tick(body, integration->dt);
+    scene_update_rest_time(scene, index, integration->dt);
+  }
+}
+
+/**
+ * Ticks every body that is not resting, spreading them across the scene's
+ * worker threads if there are enough.
+ * Fast bodies are then swept one at a time, in order, since sweeping reads
+ * other bodies. The bodies they are swept against are never moved by a tick,
+ * so this gives the same result as ticking every body in order.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param dt the time elapsed since the last tick, in seconds
+ * @return the indices of the bodies marked for removal, in increasing order
+ */
+static index_list_t scene_integrate(scene_t *scene, double dt) {
+  size_t num_workers =
+      scene_pass_workers(scene, scene->num_bodies, PARALLEL_MIN_BODIES);
+  index_list_t *fast = malloc(sizeof(index_list_t) * num_workers);
+  index_list_t *removed = malloc(sizeof(index_list_t) * num_workers);
+  assert(fast);
+  assert(removed);
+  for (size_t i = 0; i < num_workers; i++) {
+    fast[i] = index_list_init(INIT_SIZE);
+    removed[i] = index_list_init(1);
+  }
+  integration_t integration = {
+      .scene = scene, .dt = dt, .fast = fast, .removed = removed};
+  if (num_workers == 1) {
+    for (size_t i = 0; i < scene->num_bodies; i++) {
+      scene_integrate_body(i, 0, &integration);
+    }
+  } else {
+    thread_pool_for(scene->pool, scene->num_bodies, BODY_CHUNK,
+                    (thread_pool_task_t)scene_integrate_body, &integration);
+  }
+
+  // workers take consecutive runs of bodies, but not necessarily in order
+  index_list_t merged = fast[0];
+  index_list_t merged_removed = removed[0];
+  for (size_t i = 1; i < num_workers; i++) {
+    for (size_t j = 0; j < fast[i].size; j++) {
+      index_list_add(&merged, fast[i].data[j]);
+    }
+    for (size_t j = 0; j < removed[i].size; j++) {
+      index_list_add(&merged_removed, removed[i].data[j]);
+    }
+    index_list_free(&fast[i]);
+    index_list_free(&removed[i]);
+  }
+  free(fast);
+  free(removed);
+  if (num_workers > 1) {
+    qsort(merged.data, merged.size, sizeof(size_t), index_compare);
+    qsort(merged_removed.data, merged_removed.size, sizeof(size_t),
+          index_compare);
+  }
+  for (size_t i = 0; i < merged.size; i++) {
+    scene_tick_swept(scene, scene->bodies.data[merged.data[i]], dt);
+    scene_update_rest_time(scene, merged.data[i], dt);
+  }
+  index_list_free(&merged);
+  return merged_removed;
+}
+
+void scene_tick(scene_t *scene, double dt) {
+  handle_list_clear(&scene->removed);
+  scene_invalidate_bvh(scene, false);
+
+  scene_run_forces(scene);
+  // bodies woken since the last tick, or by a force creator, search for
+  // contacts; bodies woken by a contact start moving this tick
+  scene_wake_islands(scene);
+  scene_dispatch_contacts(scene);
+  scene_wake_islands(scene);
+
+  // removed bodies are freed together once every other body has moved
+  index_list_t removed = scene_integrate(scene, dt);
+  if (removed.size > 0) {
+    scene_remove_bodies(scene, &removed);
+  }
+  index_list_free(&removed);
+  if (scene->sleep_speed > 0) {
+    scene_sleep_islands(scene);
+  }
+}
+
+void scene_save_poses(scene_t *scene) {
+  for (size_t i = 0; i < scene->num_bodies; i++) {
+    body_save_pose(scene->bodies.data[i]);
+  }
+}
+
+typedef struct scene_query {
+  body_filter_t filter;
+  body_t *shape;
+  vector_t origin;
+  vector_t displacement;
+  double time;
+  scene_hit_t hit;
+} scene_query_t;
+
+/**
+ * Returns whether a query should test a body.
+ *
+ * @param query the query being run
+ * @param body a body in the scene
+ * @return whether the body can be hit
+ */
+static bool scene_query_accepts(scene_query_t *query, body_t *body) {
+  return body != query->shape && !body_is_removed(body) &&
+         !body_is_sensor(body) &&
+         (query->filter == NULL || query->filter(body));
+}
+
+/**
+ * Records a hit if it is closer than the closest hit found so far.
+ *
+ * @param query the query being run
+ * @param body the body hit
+ * @param time the fraction of the query's displacement travelled
+ * @param axis the axis of the hit, pointing into the body
+ */
+static void scene_query_record(scene_query_t *query, body_t *body,
+                               double time, vector_t axis) {
+  if (query->hit.hit && time >= query->time) {
+    return;
+  }
+  query->time = time;
+  query->hit = (scene_hit_t){.hit = true,
+                             .body = body,
+                             .distance =
+                                 time * vec_get_length(query->displacement),
+                             .normal = vec_negate(axis)};
+}
+
+/**
+ * Tests a ray against one body found by the bounding volume hierarchy.
+ *
+ * @param body a body whose bounding box the ray reaches
+ * @param query the raycast being run
+ * @return the fraction of the ray still to search
+ */
+static double scene_raycast_body(body_t *body, scene_query_t *query) {
+  if (scene_query_accepts(query, body)) {
+    impact_info_t impact =
+        find_ray_impact(query->origin, query->displacement, body);
+    if (impact.hit) {
+      scene_query_record(query, body, impact.time, impact.axis);
+    }
+  }
+  return query->hit.hit ? query->time : 1;
+}
+
+/**
+ * Tests a moving shape against one body found by the bounding volume
+ * hierarchy.
+ *
+ * @param body a body whose bounding box the shape's box reaches
+ * @param query the shape cast being run
+ * @return the fraction of the motion still to search
+ */
+static double scene_shape_cast_body(body_t *body, scene_query_t *query) {
+  if (scene_query_accepts(query, body)) {
+    impact_info_t impact =
+        find_time_of_impact(query->shape, query->displacement, body);
+    if (impact.hit) {
+      scene_query_record(query, body, impact.time, impact.axis);
+    } else if (impact.time < 0 && impact.exit_time > 0) {
+      // already overlapping: only a hit if moving mostly further in
+      collision_info_t overlap = find_collision(query->shape, body);
+      double length = vec_get_length(query->displacement);
+      if (overlap.collided &&
+          vec_dot(overlap.axis, query->displacement) > M_SQRT1_2 * length) {
+        scene_query_record(query, body, 0, overlap.axis);
+      }
+    }
+  }
+  return query->hit.hit ? query->time : 1;
+}
+
+/**
+ * Runs a sweep through the scene's bounding volume hierarchies,
+ * building each first if its bodies have moved since it was last built.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param box the box at the start of the sweep
+ * @param query the query being run
+ * @param callback the function to test each body the box may touch
+ */
+static void scene_sweep(scene_t *scene, aabb_t box, scene_query_t *query,
+                        bvh_sweep_callback_t callback) {
+  // the query keeps the closest hit across both sweeps
+  scene_tree_build(scene, &scene->static_tree, scene_is_resting);
+  bvh_sweep(scene->static_tree.bvh, box, query->displacement, callback, query);
+  scene_tree_build(scene, &scene->moving_tree, scene_is_moving);
+  bvh_sweep(scene->moving_tree.bvh, box, query->displacement, callback, query);
+}
+
+scene_hit_t scene_raycast(scene_t *scene, vector_t origin, vector_t dir,
+                          double max_dist, body_filter_t filter) {
+  double length = vec_get_length(dir);
+  assert(length > 0);
+  scene_query_t query = {.filter = filter,
+                         .shape = NULL,
+                         .origin = origin,
+                         .displacement = vec_multiply(max_dist / length, dir),
+                         .hit = {.hit = false}};
+  scene_sweep(scene, (aabb_t){.min = origin, .max = origin}, &query,
+              (bvh_sweep_callback_t)scene_raycast_body);
+  return query.hit;
+}
+
+scene_hit_t scene_shape_cast(scene_t *scene, body_t *shape, vector_t dir,
+                             double max_dist, body_filter_t filter) {
+  double length = vec_get_length(dir);
+  assert(length > 0);
+  scene_query_t query = {.filter = filter,
+                         .shape = shape,
+                         .origin = body_get_centroid(shape),
+                         .displacement = vec_multiply(max_dist / length, dir),
+                         .hit = {.hit = false}};
+  scene_sweep(scene, aabb_from_body(shape), &query,
+              (bvh_sweep_callback_t)scene_shape_cast_body);
+  return query.hit;
+}
+
+void scene_free(scene_t *scene) {
+  scene_invalidate_bvh(scene, true);
+  for (size_t i = 0; i < scene->islands.size; i++) {
+    body_list_free(&scene->islands.data[i]);
+  }
+  island_list_free(&scene->islands);
+  time_list_free(&scene->rest_times);
+  body_pair_list_free(&scene->links);
+  handle_list_free(&scene->removed);
+  if (scene->pool != NULL) {
+    thread_pool_free(scene->pool);
+  }
+  for (size_t i = 0; i < scene->num_bodies; i++) {
+    body_free(scene->bodies.data[i]);
+  }
+  body_list_free(&scene->bodies);
+  for (size_t i = 0; i < scene->kinds.size; i++) {
+    body_list_free(&scene->kinds.data[i]);
+  }
+  kind_list_free(&scene->kinds);
+  for (size_t i = 0; i < scene->force_creators.size; i++) {
+    force_free(scene->force_creators.data[i]);
+  }
+  force_list_free(&scene->force_creators);
+  index_list_free(&scene->force_order);
+  index_list_free(&scene->force_groups);
+  contact_list_free(&scene->contacts);
+  for (size_t i = 0; i < MAX_CATEGORIES; i++) {
+    for (size_t j = 0; j < MAX_CATEGORIES; j++) {
+      if (scene->handlers[i][j] != NULL) {
+        list_free(scene->handlers[i][j]);
+      }
+    }
+  }
+  free(scene);
+}
@@ -1,4 +1,5 @@
 #include "sdl_wrapper.h"
+#include "vector_batch.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL2_gfxPrimitives.h>
 #include <SDL2/SDL_image.h>
@@ -55,6 +56,10 @@ uint32_t key_start_timestamp;
  * Initially 0.
  */
 clock_t last_clock = 0;
+/**
+ * How far between their previous and current poses bodies are drawn.
+ */
+static double render_alpha = 1;
 
 /** Computes the center of the window in pixel coordinates */
 vector_t get_window_center(void) {
@@ -189,36 +194,34 @@ void sdl_clear(void) {
   SDL_RenderClear(renderer);
 }
 
-SDL_Rect sdl_get_body_bounding_box(body_t *body) {
-  vector_t vert = {.x = __DBL_MAX__, .y = -__DBL_MAX__};
-  vector_t horiz = {.x = -__DBL_MAX__, .y = __DBL_MAX__};
-  list_t *points = body_get_shape(body);
-  size_t n = list_size(points);
-  vector_t window_center = get_window_center();
-  for (size_t i = 0; i < n; i++) {
-    vector_t *vertex = list_get(points, i);
-    vector_t pixel = get_window_position(*vertex, window_center);
-    if (pixel.y > vert.y) {
-      vert.y = pixel.y;
-    } else if (pixel.y < horiz.y) {
-      horiz.y = pixel.y;
-    }
+void sdl_set_interpolation(double alpha) { render_alpha = alpha; }
 
-    if (pixel.x > horiz.x) {
-      horiz.x = pixel.x;
-    } else if (pixel.x < vert.x) {
-      vert.x = pixel.x;
-    }
-  }
+SDL_Rect sdl_get_body_bounding_box(body_t *body) {
+  aabb_t box = body_get_bounding_box(body);
+  vector_t shift = vec_subtract(
+      body_get_interpolated_centroid(body, render_alpha),
+      body_get_centroid(body));
+  return sdl_get_bounding_box(vec_add(box.min, shift),
+                              vec_add(box.max, shift));
+}
 
-  return (SDL_Rect){
-      .x = vert.x, .y = horiz.y, .w = horiz.x - vert.x, .h = vert.y - horiz.y};
+SDL_Rect sdl_get_bounding_box(vector_t min, vector_t max) {
+  vector_t window_center = get_window_center();
+  // the scene's top left corner has the smallest x but the largest y
+  vector_t top_left =
+      get_window_position((vector_t){min.x, max.y}, window_center);
+  vector_t bottom_right =
+      get_window_position((vector_t){max.x, min.y}, window_center);
+  return (SDL_Rect){.x = top_left.x,
+                    .y = top_left.y,
+                    .w = bottom_right.x - top_left.x,
+                    .h = bottom_right.y - top_left.y};
 }
 
 void sdl_draw_body(body_t *body) {
   // Check parameters
-  list_t *points = body_get_shape(body);
-  size_t n = list_size(points);
+  shape_view_t shape = body_get_shape_view(body);
+  size_t n = shape.count;
   assert(n >= 3);
   color_t color = body_get_color(body);
   double r = color.red;
@@ -232,24 +235,36 @@ void sdl_draw_body(body_t *body) {
   vector_t window_center = get_window_center();
 
   // Convert each vertex to a point on screen
+  sim_vector_t *pixels = malloc(sizeof(*pixels) * n);
   int16_t *x_points = malloc(sizeof(*x_points) * n),
           *y_points = malloc(sizeof(*y_points) * n);
+  assert(pixels != NULL);
   assert(x_points != NULL);
   assert(y_points != NULL);
+  // rotate the vertices about the centroid from the current rotation to the
+  // interpolated one, then move them to the interpolated centroid
+  vector_t centroid = body_get_centroid(body);
+  double angle = body_get_interpolated_rotation(body, render_alpha) -
+                 body_get_rotation(body);
+  double cos_angle = cos(angle), sin_angle = sin(angle);
+  vector_t offset =
+      vec_subtract(body_get_interpolated_centroid(body, render_alpha),
+                   vec_rotate(centroid, angle));
+  vec_batch_transform(pixels, shape.vertices, n, cos_angle, sin_angle, offset);
+  vec_batch_to_window(pixels, pixels, n, center,
+                      get_scene_scale(window_center), window_center);
   for (size_t i = 0; i < n; i++) {
-    vector_t *vertex = list_get(points, i);
-    vector_t pixel = get_window_position(*vertex, window_center);
-    x_points[i] = pixel.x;
-    y_points[i] = pixel.y;
+    x_points[i] = pixels[i].x;
+    y_points[i] = pixels[i].y;
   }
 
   // Draw body with the given color
   filledPolygonRGBA(renderer, x_points, y_points, n, r * 255, g * 255, b * 255,
                     255);
   sdl_show();
+  free(pixels);
   free(x_points);
   free(y_points);
-  list_free(points);
 }
 
 SDL_Texture *sdl_get_image_texture(const char *image_path) {
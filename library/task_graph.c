@@ -0,0 +1,135 @@
+#include "task_graph.h"
+#include "array.h"
+#include "thread_pool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+const size_t INIT_SYSTEMS = 8;
+
+typedef struct system_entry {
+  task_system_t system;
+  void *aux;
+  uint32_t reads;
+  uint32_t writes;
+  bool main_thread;
+  // the stage the system runs in; see struct task_graph
+  size_t stage;
+} system_entry_t;
+
+// a growable array of systems
+ARRAY_DEFINE(system_list, system_entry_t)
+// a growable array of positions of systems
+ARRAY_DEFINE(index_list, size_t)
+
+/**
+ * Systems run in stages, one after another. Each system runs in the stage
+ * after the last stage with a system it conflicts with, so no two systems in
+ * a stage conflict, and all of them can run at once.
+ */
+struct task_graph {
+  thread_pool_t *pool;
+  system_list_t systems;
+  size_t num_stages;
+  // the systems of the stage being run, split by whether they must run on
+  // the main thread
+  index_list_t pooled;
+  index_list_t main;
+};
+
+task_graph_t *task_graph_init(size_t num_workers) {
+  task_graph_t *graph = malloc(sizeof(task_graph_t));
+  assert(graph);
+  graph->pool = thread_pool_init(num_workers);
+  graph->systems = system_list_init(INIT_SYSTEMS);
+  graph->num_stages = 0;
+  graph->pooled = index_list_init(INIT_SYSTEMS);
+  graph->main = index_list_init(INIT_SYSTEMS);
+  return graph;
+}
+
+/**
+ * Returns whether two systems conflict, i.e. one of them writes a resource
+ * that the other reads or writes.
+ *
+ * @param a the first system
+ * @param b the second system
+ * @return whether the systems must not run at the same time
+ */
+static bool systems_conflict(system_entry_t *a, system_entry_t *b) {
+  return (a->writes & (b->reads | b->writes)) != 0 ||
+         (b->writes & a->reads) != 0;
+}
+
+void task_graph_add(task_graph_t *graph, task_system_t system, void *aux,
+                    uint32_t reads, uint32_t writes, bool main_thread) {
+  system_entry_t entry = {.system = system,
+                          .aux = aux,
+                          .reads = reads,
+                          .writes = writes,
+                          .main_thread = main_thread,
+                          .stage = 0};
+  for (size_t i = 0; i < graph->systems.size; i++) {
+    system_entry_t *earlier = &graph->systems.data[i];
+    if (earlier->stage >= entry.stage && systems_conflict(earlier, &entry)) {
+      entry.stage = earlier->stage + 1;
+    }
+  }
+  system_list_add(&graph->systems, entry);
+  if (entry.stage >= graph->num_stages) {
+    graph->num_stages = entry.stage + 1;
+  }
+}
+
+/**
+ * Runs one of the current stage's systems that can run on any thread.
+ *
+ * @param index the system's position among them
+ * @param worker the worker running it
+ * @param graph the graph being run
+ */
+static void task_graph_run_pooled(size_t index, size_t worker,
+                                  task_graph_t *graph) {
+  system_entry_t *entry = &graph->systems.data[graph->pooled.data[index]];
+  entry->system(entry->aux);
+}
+
+/**
+ * Runs the current stage's systems that must run on the main thread,
+ * in the order they were added.
+ *
+ * @param graph the graph being run
+ */
+static void task_graph_run_main(task_graph_t *graph) {
+  for (size_t i = 0; i < graph->main.size; i++) {
+    system_entry_t *entry = &graph->systems.data[graph->main.data[i]];
+    entry->system(entry->aux);
+  }
+}
+
+void task_graph_run(task_graph_t *graph) {
+  for (size_t stage = 0; stage < graph->num_stages; stage++) {
+    index_list_clear(&graph->pooled);
+    index_list_clear(&graph->main);
+    for (size_t i = 0; i < graph->systems.size; i++) {
+      system_entry_t *entry = &graph->systems.data[i];
+      if (entry->stage == stage) {
+        index_list_add(entry->main_thread ? &graph->main : &graph->pooled, i);
+      }
+    }
+    // the main thread runs its systems while the workers start on the others
+    thread_pool_for_with_job(
+        graph->pool, graph->pooled.size, 1,
+        (thread_pool_task_t)task_graph_run_pooled, graph,
+        graph->main.size > 0 ? (thread_pool_job_t)task_graph_run_main : NULL,
+        graph);
+  }
+}
+
+void task_graph_free(task_graph_t *graph) {
+  thread_pool_free(graph->pool);
+  system_list_free(&graph->systems);
+  index_list_free(&graph->pooled);
+  index_list_free(&graph->main);
+  free(graph);
+}
@@ -0,0 +1,270 @@
+#include "thread_pool.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// the size of a cache line; each worker's chunks are on their own one
+#define CACHE_LINE 64
+
+typedef struct worker {
+  thread_pool_t *pool;
+  size_t id;
+} worker_t;
+
+/**
+ * The chunks of the current loop that a worker has yet to run, as the
+ * positions of the first chunk (in the high 32 bits) and one past the last
+ * (in the low 32 bits), packed into one word so the worker and thieves can
+ * each claim a chunk with a single compare-and-swap.
+ * The worker runs its chunks from the front, so it walks through consecutive
+ * iterations; workers that run out steal from the back.
+ */
+typedef struct chunk_range {
+  _Alignas(CACHE_LINE) atomic_uint_least64_t bounds;
+} chunk_range_t;
+
+struct thread_pool {
+  pthread_t *threads;
+  worker_t *workers;
+  size_t num_threads;
+
+  pthread_mutex_t lock;
+  pthread_cond_t work_ready;
+  pthread_cond_t work_done;
+  // incremented each time a loop starts, so workers can tell it is new
+  size_t generation;
+  // the number of threads still working on the current loop
+  size_t busy;
+  bool stopping;
+
+  thread_pool_task_t task;
+  void *aux;
+  size_t count;
+  size_t chunk;
+  // the chunks each worker has left, indexed by worker
+  chunk_range_t *ranges;
+};
+
+/**
+ * Claims a chunk from a worker's range.
+ *
+ * @param range the range to claim from
+ * @param back whether to claim the last chunk (when stealing) rather than the
+ * first
+ * @param chunk set to the position of the claimed chunk
+ * @return whether a chunk was claimed, i.e. the range was not empty
+ */
+static bool chunk_range_claim(chunk_range_t *range, bool back, size_t *chunk) {
+  uint_least64_t bounds = atomic_load(&range->bounds);
+  while (true) {
+    uint32_t first = bounds >> 32, end = (uint32_t)bounds;
+    if (first >= end) {
+      return false;
+    }
+    uint_least64_t claimed = back ? bounds - 1 : bounds + ((uint64_t)1 << 32);
+    if (atomic_compare_exchange_weak(&range->bounds, &bounds, claimed)) {
+      *chunk = back ? end - 1 : first;
+      return true;
+    }
+  }
+}
+
+/**
+ * Runs the iterations of one chunk of the current loop.
+ *
+ * @param pool the pool running the loop
+ * @param worker the id of the worker doing the work
+ * @param chunk the position of the chunk
+ */
+static void thread_pool_run_chunk(thread_pool_t *pool, size_t worker,
+                                  size_t chunk) {
+  size_t start = chunk * pool->chunk;
+  size_t end =
+      start + pool->chunk < pool->count ? start + pool->chunk : pool->count;
+  for (size_t i = start; i < end; i++) {
+    pool->task(i, worker, pool->aux);
+  }
+}
+
+/**
+ * Runs a worker's own chunks of the current loop, then steals chunks from the
+ * other workers until none are left.
+ *
+ * @param pool the pool running the loop
+ * @param worker the id of the worker doing the work
+ */
+static void thread_pool_run_chunks(thread_pool_t *pool, size_t worker) {
+  size_t num_workers = thread_pool_workers(pool);
+  size_t chunk;
+  while (chunk_range_claim(&pool->ranges[worker], false, &chunk)) {
+    thread_pool_run_chunk(pool, worker, chunk);
+  }
+  // chunks are never added during a loop, so once every range has been seen
+  // empty in turn, there is nothing left to steal
+  size_t empty = 0;
+  for (size_t victim = (worker + 1) % num_workers; empty < num_workers - 1;
+       victim = (victim + 1) % num_workers) {
+    if (victim == worker) {
+      continue;
+    }
+    if (chunk_range_claim(&pool->ranges[victim], true, &chunk)) {
+      thread_pool_run_chunk(pool, worker, chunk);
+      empty = 0;
+    } else {
+      empty++;
+    }
+  }
+}
+
+/**
+ * The body of each worker thread: waits for a loop, helps run it,
+ * and reports when it is done, until the pool is stopped.
+ *
+ * @param arg the worker_t describing this thread
+ * @return NULL
+ */
+static void *thread_pool_worker(void *arg) {
+  worker_t *worker = arg;
+  thread_pool_t *pool = worker->pool;
+  size_t seen = 0;
+
+  while (true) {
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopping && pool->generation == seen) {
+      pthread_cond_wait(&pool->work_ready, &pool->lock);
+    }
+    if (pool->stopping) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    thread_pool_run_chunks(pool, worker->id);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->busy--;
+    if (pool->busy == 0) {
+      pthread_cond_signal(&pool->work_done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+thread_pool_t *thread_pool_init(size_t num_workers) {
+  if (num_workers == 0) {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    num_workers = processors > 0 ? (size_t)processors : 1;
+  }
+
+  thread_pool_t *pool = malloc(sizeof(thread_pool_t));
+  assert(pool);
+  pool->threads = malloc(sizeof(pthread_t) * num_workers);
+  pool->workers = malloc(sizeof(worker_t) * num_workers);
+  assert(pool->threads);
+  assert(pool->workers);
+  pool->num_threads = 0;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work_ready, NULL);
+  pthread_cond_init(&pool->work_done, NULL);
+  pool->generation = 0;
+  pool->busy = 0;
+  pool->stopping = false;
+  pool->ranges = aligned_alloc(CACHE_LINE, sizeof(chunk_range_t) * num_workers);
+  assert(pool->ranges);
+  for (size_t i = 0; i < num_workers; i++) {
+    atomic_init(&pool->ranges[i].bounds, 0);
+  }
+
+  // worker 0 is the calling thread
+  for (size_t i = 1; i < num_workers; i++) {
+    worker_t *worker = &pool->workers[pool->num_threads];
+    worker->pool = pool;
+    worker->id = i;
+    if (pthread_create(&pool->threads[pool->num_threads], NULL,
+                       thread_pool_worker, worker) != 0) {
+      break;
+    }
+    pool->num_threads++;
+  }
+  return pool;
+}
+
+size_t thread_pool_workers(thread_pool_t *pool) {
+  return pool->num_threads + 1;
+}
+
+void thread_pool_for(thread_pool_t *pool, size_t count, size_t chunk,
+                     thread_pool_task_t task, void *aux) {
+  thread_pool_for_with_job(pool, count, chunk, task, aux, NULL, NULL);
+}
+
+void thread_pool_for_with_job(thread_pool_t *pool, size_t count, size_t chunk,
+                              thread_pool_task_t task, void *aux,
+                              thread_pool_job_t job, void *job_aux) {
+  assert(chunk > 0);
+  // a loop of one chunk is only worth handing out if the calling thread is
+  // busy with a job meanwhile
+  if (pool->num_threads == 0 || count == 0 || (job == NULL && count <= chunk)) {
+    if (job != NULL) {
+      job(job_aux);
+    }
+    for (size_t i = 0; i < count; i++) {
+      task(i, 0, aux);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->task = task;
+  pool->aux = aux;
+  pool->count = count;
+  pool->chunk = chunk;
+  // each worker starts on an equal share of consecutive chunks
+  size_t num_workers = thread_pool_workers(pool);
+  size_t num_chunks = (count + chunk - 1) / chunk;
+  assert(num_chunks <= UINT32_MAX);
+  for (size_t i = 0; i < num_workers; i++) {
+    uint_least64_t first = num_chunks * i / num_workers;
+    uint_least64_t end = num_chunks * (i + 1) / num_workers;
+    atomic_store(&pool->ranges[i].bounds, first << 32 | end);
+  }
+  pool->busy = pool->num_threads;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->work_ready);
+  pthread_mutex_unlock(&pool->lock);
+
+  if (job != NULL) {
+    job(job_aux);
+  }
+  thread_pool_run_chunks(pool, 0);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->busy > 0) {
+    pthread_cond_wait(&pool->work_done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_free(thread_pool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->work_ready);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i = 0; i < pool->num_threads; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->work_ready);
+  pthread_cond_destroy(&pool->work_done);
+  free(pool->threads);
+  free(pool->workers);
+  free(pool->ranges);
+  free(pool);
+}
@@ -0,0 +1,4 @@
+#include "vector.h"
+
+// every other vector operation is defined inline in vector.h
+const vector_t VEC_ZERO = {.x = 0, .y = 0};
@@ -0,0 +1,338 @@
+#include "vector_batch.h"
+
+#include <math.h>
+
+// SIMD helpers. Each register holds POINTS whole vectors, stored as
+// consecutive (x, y) pairs just like an array of sim_vector_t, so a register
+// holds twice as many when the simulation stores floats.
+#if defined(SIM_FLOAT32) && defined(__AVX__)
+#include <immintrin.h>
+#define POINTS 4
+typedef __m256 points_t;
+static inline points_t points_load(const sim_vector_t *p) {
+  return _mm256_loadu_ps((const float *)p);
+}
+static inline void points_store(sim_vector_t *p, points_t a) {
+  _mm256_storeu_ps((float *)p, a);
+}
+static inline points_t points_set(double x, double y) {
+  return _mm256_setr_ps(x, y, x, y, x, y, x, y);
+}
+static inline points_t points_add(points_t a, points_t b) {
+  return _mm256_add_ps(a, b);
+}
+static inline points_t points_sub(points_t a, points_t b) {
+  return _mm256_sub_ps(a, b);
+}
+static inline points_t points_mul(points_t a, points_t b) {
+  return _mm256_mul_ps(a, b);
+}
+static inline points_t points_min(points_t a, points_t b) {
+  return _mm256_min_ps(a, b);
+}
+static inline points_t points_max(points_t a, points_t b) {
+  return _mm256_max_ps(a, b);
+}
+static inline points_t points_swap(points_t a) {
+  return _mm256_permute_ps(a, 0xB1);
+}
+#elif defined(SIM_FLOAT32) && defined(__SSE__)
+#include <xmmintrin.h>
+#define POINTS 2
+typedef __m128 points_t;
+static inline points_t points_load(const sim_vector_t *p) {
+  return _mm_loadu_ps((const float *)p);
+}
+static inline void points_store(sim_vector_t *p, points_t a) {
+  _mm_storeu_ps((float *)p, a);
+}
+static inline points_t points_set(double x, double y) {
+  return _mm_setr_ps(x, y, x, y);
+}
+static inline points_t points_add(points_t a, points_t b) {
+  return _mm_add_ps(a, b);
+}
+static inline points_t points_sub(points_t a, points_t b) {
+  return _mm_sub_ps(a, b);
+}
+static inline points_t points_mul(points_t a, points_t b) {
+  return _mm_mul_ps(a, b);
+}
+static inline points_t points_min(points_t a, points_t b) {
+  return _mm_min_ps(a, b);
+}
+static inline points_t points_max(points_t a, points_t b) {
+  return _mm_max_ps(a, b);
+}
+static inline points_t points_swap(points_t a) {
+  return _mm_shuffle_ps(a, a, 0xB1);
+}
+#elif defined(SIM_FLOAT32) && defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define POINTS 2
+typedef v128_t points_t;
+static inline points_t points_load(const sim_vector_t *p) {
+  return wasm_v128_load(p);
+}
+static inline void points_store(sim_vector_t *p, points_t a) {
+  wasm_v128_store(p, a);
+}
+static inline points_t points_set(double x, double y) {
+  return wasm_f32x4_make(x, y, x, y);
+}
+static inline points_t points_add(points_t a, points_t b) {
+  return wasm_f32x4_add(a, b);
+}
+static inline points_t points_sub(points_t a, points_t b) {
+  return wasm_f32x4_sub(a, b);
+}
+static inline points_t points_mul(points_t a, points_t b) {
+  return wasm_f32x4_mul(a, b);
+}
+static inline points_t points_min(points_t a, points_t b) {
+  return wasm_f32x4_pmin(a, b);
+}
+static inline points_t points_max(points_t a, points_t b) {
+  return wasm_f32x4_pmax(a, b);
+}
+static inline points_t points_swap(points_t a) {
+  return wasm_i32x4_shuffle(a, a, 1, 0, 3, 2);
+}
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define POINTS 2
+typedef __m256d points_t;
+static inline points_t points_load(const sim_vector_t *p) {
+  return _mm256_loadu_pd((const double *)p);
+}
+static inline void points_store(sim_vector_t *p, points_t a) {
+  _mm256_storeu_pd((double *)p, a);
+}
+static inline points_t points_set(double x, double y) {
+  return _mm256_setr_pd(x, y, x, y);
+}
+static inline points_t points_add(points_t a, points_t b) {
+  return _mm256_add_pd(a, b);
+}
+static inline points_t points_sub(points_t a, points_t b) {
+  return _mm256_sub_pd(a, b);
+}
+static inline points_t points_mul(points_t a, points_t b) {
+  return _mm256_mul_pd(a, b);
+}
+static inline points_t points_min(points_t a, points_t b) {
+  return _mm256_min_pd(a, b);
+}
+static inline points_t points_max(points_t a, points_t b) {
+  return _mm256_max_pd(a, b);
+}
+static inline points_t points_swap(points_t a) {
+  return _mm256_permute_pd(a, 0x5);
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define POINTS 1
+typedef __m128d points_t;
+static inline points_t points_load(const sim_vector_t *p) {
+  return _mm_loadu_pd((const double *)p);
+}
+static inline void points_store(sim_vector_t *p, points_t a) {
+  _mm_storeu_pd((double *)p, a);
+}
+static inline points_t points_set(double x, double y) {
+  return _mm_setr_pd(x, y);
+}
+static inline points_t points_add(points_t a, points_t b) {
+  return _mm_add_pd(a, b);
+}
+static inline points_t points_sub(points_t a, points_t b) {
+  return _mm_sub_pd(a, b);
+}
+static inline points_t points_mul(points_t a, points_t b) {
+  return _mm_mul_pd(a, b);
+}
+static inline points_t points_min(points_t a, points_t b) {
+  return _mm_min_pd(a, b);
+}
+static inline points_t points_max(points_t a, points_t b) {
+  return _mm_max_pd(a, b);
+}
+static inline points_t points_swap(points_t a) {
+  return _mm_shuffle_pd(a, a, 1);
+}
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define POINTS 1
+typedef v128_t points_t;
+static inline points_t points_load(const sim_vector_t *p) {
+  return wasm_v128_load(p);
+}
+static inline void points_store(sim_vector_t *p, points_t a) {
+  wasm_v128_store(p, a);
+}
+static inline points_t points_set(double x, double y) {
+  return wasm_f64x2_make(x, y);
+}
+static inline points_t points_add(points_t a, points_t b) {
+  return wasm_f64x2_add(a, b);
+}
+static inline points_t points_sub(points_t a, points_t b) {
+  return wasm_f64x2_sub(a, b);
+}
+static inline points_t points_mul(points_t a, points_t b) {
+  return wasm_f64x2_mul(a, b);
+}
+static inline points_t points_min(points_t a, points_t b) {
+  return wasm_f64x2_pmin(a, b);
+}
+static inline points_t points_max(points_t a, points_t b) {
+  return wasm_f64x2_pmax(a, b);
+}
+static inline points_t points_swap(points_t a) {
+  return wasm_i64x2_shuffle(a, a, 1, 0);
+}
+#else
+#define POINTS 1
+typedef sim_vector_t points_t;
+static inline points_t points_load(const sim_vector_t *p) { return *p; }
+static inline void points_store(sim_vector_t *p, points_t a) { *p = a; }
+static inline points_t points_set(double x, double y) {
+  return (points_t){.x = x, .y = y};
+}
+static inline points_t points_add(points_t a, points_t b) {
+  return (points_t){.x = a.x + b.x, .y = a.y + b.y};
+}
+static inline points_t points_sub(points_t a, points_t b) {
+  return (points_t){.x = a.x - b.x, .y = a.y - b.y};
+}
+static inline points_t points_mul(points_t a, points_t b) {
+  return (points_t){.x = a.x * b.x, .y = a.y * b.y};
+}
+static inline points_t points_min(points_t a, points_t b) {
+  return (points_t){.x = b.x < a.x ? b.x : a.x, .y = b.y < a.y ? b.y : a.y};
+}
+static inline points_t points_max(points_t a, points_t b) {
+  return (points_t){.x = a.x < b.x ? b.x : a.x, .y = a.y < b.y ? b.y : a.y};
+}
+static inline points_t points_swap(points_t a) {
+  return (points_t){.x = a.y, .y = a.x};
+}
+#endif
+
+/**
+ * Rotates the vectors in a register, given registers holding
+ * (cos, cos) and (-sin, sin) for each vector.
+ */
+static inline points_t points_rotate(points_t p, points_t cos_angle,
+                                     points_t sin_angle) {
+  return points_add(points_mul(p, cos_angle),
+                    points_mul(points_swap(p), sin_angle));
+}
+
+void vec_batch_translate(sim_vector_t *out, const sim_vector_t *in, size_t n,
+                         vector_t offset) {
+  points_t offsets = points_set(offset.x, offset.y);
+  size_t i = 0;
+  for (; i + POINTS <= n; i += POINTS) {
+    points_store(&out[i], points_add(points_load(&in[i]), offsets));
+  }
+  for (; i < n; i++) {
+    out[i] = vec_to_sim(vec_add(vec_from_sim(in[i]), offset));
+  }
+}
+
+void vec_batch_scale(sim_vector_t *out, const sim_vector_t *in, size_t n,
+                     vector_t scale) {
+  points_t scales = points_set(scale.x, scale.y);
+  size_t i = 0;
+  for (; i + POINTS <= n; i += POINTS) {
+    points_store(&out[i], points_mul(points_load(&in[i]), scales));
+  }
+  for (; i < n; i++) {
+    vector_t v = vec_from_sim(in[i]);
+    out[i] = vec_to_sim((vector_t){.x = v.x * scale.x, .y = v.y * scale.y});
+  }
+}
+
+void vec_batch_rotate(sim_vector_t *out, const sim_vector_t *in, size_t n,
+                      double cos_angle, double sin_angle) {
+  points_t c = points_set(cos_angle, cos_angle);
+  points_t s = points_set(-sin_angle, sin_angle);
+  size_t i = 0;
+  for (; i + POINTS <= n; i += POINTS) {
+    points_store(&out[i], points_rotate(points_load(&in[i]), c, s));
+  }
+  for (; i < n; i++) {
+    vector_t v = vec_from_sim(in[i]);
+    out[i] = vec_to_sim((vector_t){.x = v.x * cos_angle - v.y * sin_angle,
+                                   .y = v.y * cos_angle + v.x * sin_angle});
+  }
+}
+
+void vec_batch_transform(sim_vector_t *out, const sim_vector_t *in, size_t n,
+                         double cos_angle, double sin_angle, vector_t offset) {
+  points_t c = points_set(cos_angle, cos_angle);
+  points_t s = points_set(-sin_angle, sin_angle);
+  points_t offsets = points_set(offset.x, offset.y);
+  size_t i = 0;
+  for (; i + POINTS <= n; i += POINTS) {
+    points_t rotated = points_rotate(points_load(&in[i]), c, s);
+    points_store(&out[i], points_add(rotated, offsets));
+  }
+  for (; i < n; i++) {
+    vector_t v = vec_from_sim(in[i]);
+    out[i] = vec_to_sim(
+        (vector_t){.x = v.x * cos_angle - v.y * sin_angle + offset.x,
+                   .y = v.y * cos_angle + v.x * sin_angle + offset.y});
+  }
+}
+
+vector_t vec_batch_project(const sim_vector_t *in, size_t n, vector_t axis) {
+  points_t axes = points_set(axis.x, axis.y);
+  points_t max = points_set(-INFINITY, -INFINITY);
+  points_t min = points_set(INFINITY, INFINITY);
+  size_t i = 0;
+  for (; i + POINTS <= n; i += POINTS) {
+    // both halves of each vector end up holding its dot product
+    points_t product = points_mul(points_load(&in[i]), axes);
+    points_t dot = points_add(product, points_swap(product));
+    max = points_max(max, dot);
+    min = points_min(min, dot);
+  }
+
+  sim_vector_t maxes[POINTS], mins[POINTS];
+  points_store(maxes, max);
+  points_store(mins, min);
+  vector_t result = {.x = -__DBL_MAX__, .y = __DBL_MAX__};
+  for (size_t j = 0; j < POINTS; j++) {
+    result.x = fmax(result.x, maxes[j].x);
+    result.y = fmin(result.y, mins[j].x);
+  }
+  for (; i < n; i++) {
+    double dot = vec_dot(axis, vec_from_sim(in[i]));
+    result.x = fmax(result.x, dot);
+    result.y = fmin(result.y, dot);
+  }
+  return result;
+}
+
+void vec_batch_to_window(sim_vector_t *out, const sim_vector_t *in, size_t n,
+                         vector_t scene_center, double scale,
+                         vector_t window_center) {
+  points_t centers = points_set(scene_center.x, scene_center.y);
+  points_t scales = points_set(scale, -scale);
+  points_t offsets = points_set(window_center.x, window_center.y);
+  size_t i = 0;
+  for (; i + POINTS <= n; i += POINTS) {
+    points_t offset = points_sub(points_load(&in[i]), centers);
+    points_store(&out[i], points_add(offsets, points_mul(scales, offset)));
+  }
+  for (; i < n; i++) {
+    vector_t offset = vec_subtract(vec_from_sim(in[i]), scene_center);
+    out[i] = vec_to_sim((vector_t){.x = window_center.x + scale * offset.x,
+                                   .y = window_center.y + -scale * offset.y});
+  }
+  for (i = 0; i < n; i++) {
+    out[i] = (sim_vector_t){.x = round(out[i].x), .y = round(out[i].y)};
+  }
+}
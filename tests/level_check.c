@@ -0,0 +1,107 @@
+// Plays every level from a fixed script of key presses, without a window, at
+// the game's DEFAULT_TICK_RATE, and prints how each one ends.
+// "make level_check" builds this twice, once storing the simulation in doubles
+// and once in floats (see SIM_FLOAT32 in the Makefile), and checks that both
+// builds print the same thing.
+//
+// The game's state and level code live in game.c, so it is included here
+// rather than linked.
+#include "../demo/game.c"
+
+// how long each level is played for before giving up on it
+const double LEVEL_SECONDS = 60;
+
+// a key the script presses or releases, and the tick it does so before
+typedef struct key_step {
+  size_t tick;
+  char key;
+  key_event_type_t type;
+} key_step_t;
+
+typedef struct level_script {
+  screen_t screen;
+  make_level_t make_level;
+  const key_step_t *steps;
+  size_t num_steps;
+} level_script_t;
+
+// jumps onto the first platform for its gem, climbs the blocks on the right
+// to the second floor, crosses to the left and climbs onto the third floor,
+// then jumps for the lava under the fourth floor
+const key_step_t LEVEL1_STEPS[] = {
+    {25, UP_ARROW, KEY_PRESSED},     {70, RIGHT_ARROW, KEY_PRESSED},
+    {265, UP_ARROW, KEY_PRESSED},    {290, RIGHT_ARROW, KEY_PRESSED},
+    {345, UP_ARROW, KEY_PRESSED},    {365, RIGHT_ARROW, KEY_PRESSED},
+    {430, UP_ARROW, KEY_PRESSED},    {455, LEFT_ARROW, KEY_PRESSED},
+    {660, UP_ARROW, KEY_PRESSED},    {680, LEFT_ARROW, KEY_PRESSED},
+    {740, UP_ARROW, KEY_PRESSED},    {740, RIGHT_ARROW, KEY_PRESSED},
+    {771, RIGHT_ARROW, KEY_RELEASED}, {830, UP_ARROW, KEY_PRESSED},
+    {830, RIGHT_ARROW, KEY_PRESSED},
+};
+
+// collects the gem on the starting platform and presses the door button,
+// crosses the floor to press the elevator button, then walks back through
+// the open door and rides the elevator
+const key_step_t LEVEL2_STEPS[] = {
+    {30, RIGHT_ARROW, KEY_PRESSED},  {93, RIGHT_ARROW, KEY_RELEASED},
+    {100, UP_ARROW, KEY_PRESSED},    {125, LEFT_ARROW, KEY_PRESSED},
+    {210, RIGHT_ARROW, KEY_PRESSED}, {321, UP_ARROW, KEY_PRESSED},
+    {420, UP_ARROW, KEY_PRESSED},    {440, RIGHT_ARROW, KEY_PRESSED},
+    {510, UP_ARROW, KEY_PRESSED},    {549, LEFT_ARROW, KEY_PRESSED},
+    {568, LEFT_ARROW, KEY_RELEASED}, {590, UP_ARROW, KEY_PRESSED},
+    {590, LEFT_ARROW, KEY_PRESSED},  {645, LEFT_ARROW, KEY_RELEASED},
+    {700, UP_ARROW, KEY_PRESSED},    {721, LEFT_ARROW, KEY_PRESSED},
+    {815, LEFT_ARROW, KEY_RELEASED}, {1175, UP_ARROW, KEY_PRESSED},
+    {1175, LEFT_ARROW, KEY_PRESSED},
+};
+
+// presses the elevator button on the floor, jumps the lava, rides the
+// elevator up and drops onto the platform with a gem
+const key_step_t LEVEL3_STEPS[] = {
+    {30, RIGHT_ARROW, KEY_PRESSED},  {158, UP_ARROW, KEY_PRESSED},
+    {1600, LEFT_ARROW, KEY_PRESSED}, {1627, LEFT_ARROW, KEY_RELEASED},
+    {1700, UP_ARROW, KEY_PRESSED},   {1715, RIGHT_ARROW, KEY_PRESSED},
+    {2650, LEFT_ARROW, KEY_PRESSED}, {2686, LEFT_ARROW, KEY_RELEASED},
+};
+
+#define SCRIPT(screen, make_level, steps)                                      \
+  {screen, make_level, steps, sizeof(steps) / sizeof(key_step_t)}
+
+const level_script_t SCRIPTS[] = {
+    SCRIPT(LEVEL1, make_level1, LEVEL1_STEPS),
+    SCRIPT(LEVEL2, make_level2, LEVEL2_STEPS),
+    SCRIPT(LEVEL3, make_level3, LEVEL3_STEPS),
+};
+
+// plays one level from its script and prints how it ended
+void play_level(state_t *state, const level_script_t *script) {
+  go_to_level(state, script->screen, script->make_level);
+  double tick_length = 1 / state->tick_rate;
+  size_t num_ticks = LEVEL_SECONDS * state->tick_rate;
+  size_t step = 0;
+  size_t tick = 0;
+  for (; tick < num_ticks && !game_over; tick++) {
+    while (step < script->num_steps && script->steps[step].tick == tick) {
+      on_key(script->steps[step].key, script->steps[step].type, 0, state);
+      step++;
+    }
+    tick_level(state, tick_length);
+  }
+
+  const char *outcome = "unfinished";
+  if (state->level_completed[script->screen - 1]) {
+    outcome = "completed";
+  } else if (game_over) {
+    outcome = "lost";
+  }
+  printf("level %d: %s, %zu gems\n", script->screen, outcome,
+         state->gems_collected);
+}
+
+int main() {
+  state_t *state = state_init();
+  for (size_t i = 0; i < sizeof(SCRIPTS) / sizeof(level_script_t); i++) {
+    play_level(state, &SCRIPTS[i]);
+  }
+  state_free(state);
+}
@@ -0,0 +1,173 @@
+#include "array.h"
+#include "forces.h"
+#include "test_util.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// enough bodies, and pairs of them, for every stage of a tick to use threads
+const size_t NUM_PAIRS = 1024;
+const size_t GRID_WIDTH = 64;
+// wide enough that each square overlaps the squares next to it
+const double SQUARE_SIZE = 1.2;
+const double GRID_SPACING = 1;
+const size_t NUM_TICKS = 100;
+const double TICK_DT = 1.0 / 60;
+const size_t WORKER_COUNTS[] = {2, 4, 8};
+const uint32_t SQUARE_CATEGORY = 1;
+const uint32_t SENSOR_CATEGORY = 2;
+// every how many squares is a sensor
+const size_t SENSOR_EVERY = 5;
+
+// a growable array of the bodies handlers were called with, as the indices
+// they were added at
+ARRAY_DEFINE(call_list, size_t)
+
+/**
+ * Makes a square body.
+ *
+ * @param center the square's centroid
+ * @param mass the square's mass
+ * @param id the number to store as the body's info
+ * @return the body
+ */
+body_t *make_square(vector_t center, double mass, size_t id) {
+  double half = SQUARE_SIZE / 2;
+  vector_array_t shape = vector_array_init(4);
+  vector_array_add(&shape, (vector_t){center.x - half, center.y - half});
+  vector_array_add(&shape, (vector_t){center.x + half, center.y - half});
+  vector_array_add(&shape, (vector_t){center.x + half, center.y + half});
+  vector_array_add(&shape, (vector_t){center.x - half, center.y + half});
+  size_t *info = malloc(sizeof(size_t));
+  assert(info);
+  *info = id;
+  body_t *body =
+      body_init_with_shape(&shape, mass, (color_t){0, 0, 0}, info, free);
+  vector_array_free(&shape);
+  return body;
+}
+
+/**
+ * Records the bodies a collision handler is called with.
+ *
+ * @param body1 the first body
+ * @param body2 the second body
+ * @param axis the collision axis
+ * @param aux the call_list_t to add to
+ * @param force_const unused
+ */
+void record_collision(body_t *body1, body_t *body2, vector_t axis, void *aux,
+                      double force_const) {
+  call_list_add(aux, *(size_t *)body_get_info(body1));
+  call_list_add(aux, *(size_t *)body_get_info(body2));
+}
+
+/**
+ * Records the bodies and event a sensor handler is called with.
+ *
+ * @param sensor the sensor
+ * @param body the body overlapping it
+ * @param event whether the overlap started, continued or ended
+ * @param aux the call_list_t to add to
+ */
+void record_sensor(body_t *sensor, body_t *body, sensor_event_t event,
+                   void *aux) {
+  call_list_add(aux, *(size_t *)body_get_info(sensor));
+  call_list_add(aux, *(size_t *)body_get_info(body));
+  call_list_add(aux, event);
+}
+
+/**
+ * Builds a grid of overlapping squares in pairs, each pair joined by a spring
+ * and gravity and each square slowed by drag, then ticks it.
+ * Every SENSOR_EVERY-th square is a sensor.
+ *
+ * @param num_workers the number of threads the scene uses
+ * @param calls if not NULL, where to record the handlers' calls in order
+ * @return the scene after NUM_TICKS ticks
+ */
+scene_t *run_scene(size_t num_workers, call_list_t *calls) {
+  scene_t *scene = scene_init();
+  scene_set_workers(scene, num_workers);
+  if (calls != NULL) {
+    scene_add_collision_handler(scene, SQUARE_CATEGORY, SQUARE_CATEGORY,
+                                record_collision, calls, 0, NULL);
+    scene_add_sensor_handler(scene, SENSOR_CATEGORY, SQUARE_CATEGORY,
+                             record_sensor, SENSOR_ALL_EVENTS, calls, NULL);
+  }
+  for (size_t i = 0; i < 2 * NUM_PAIRS; i++) {
+    vector_t center = {(double)(i % GRID_WIDTH) * GRID_SPACING,
+                       (double)(i / GRID_WIDTH) * GRID_SPACING};
+    body_t *body = make_square(center, 1 + (double)(i % 7), i);
+    bool sensor = i % SENSOR_EVERY == 0;
+    body_set_sensor(body, sensor);
+    body_set_category(body, sensor ? SENSOR_CATEGORY : SQUARE_CATEGORY);
+    body_set_velocity(body, (vector_t){sin((double)i), cos((double)i)});
+    scene_add_body(scene, body);
+  }
+  for (size_t i = 0; i < NUM_PAIRS; i++) {
+    body_t *body1 = scene_get_body(scene, 2 * i);
+    body_t *body2 = scene_get_body(scene, 2 * i + 1);
+    create_spring(scene, 3, body1, body2);
+    create_newtonian_gravity(scene, 0.5, body1, body2);
+    create_drag(scene, 0.25, body1);
+    create_drag(scene, 0.25, body2);
+  }
+  for (size_t i = 0; i < NUM_TICKS; i++) {
+    scene_tick(scene, TICK_DT);
+  }
+  return scene;
+}
+
+void test_workers_match_one_thread() {
+  scene_t *expected = run_scene(1, NULL);
+  for (size_t i = 0; i < sizeof(WORKER_COUNTS) / sizeof(*WORKER_COUNTS); i++) {
+    scene_t *scene = run_scene(WORKER_COUNTS[i], NULL);
+    assert(scene_bodies(scene) == scene_bodies(expected));
+    for (size_t j = 0; j < scene_bodies(scene); j++) {
+      body_t *body = scene_get_body(scene, j);
+      body_t *expected_body = scene_get_body(expected, j);
+      assert(vec_equal(body_get_centroid(body),
+                       body_get_centroid(expected_body)));
+      assert(vec_equal(body_get_velocity(body),
+                       body_get_velocity(expected_body)));
+    }
+    scene_free(scene);
+  }
+  scene_free(expected);
+  body_store_free();
+}
+
+void test_handler_order_matches_one_thread() {
+  call_list_t expected = call_list_init(1);
+  scene_free(run_scene(1, &expected));
+  // the squares start overlapping, so each tick's handlers have many pairs
+  assert(expected.size > 0);
+  for (size_t i = 0; i < sizeof(WORKER_COUNTS) / sizeof(*WORKER_COUNTS); i++) {
+    call_list_t calls = call_list_init(expected.size);
+    scene_free(run_scene(WORKER_COUNTS[i], &calls));
+    assert(calls.size == expected.size);
+    assert(memcmp(calls.data, expected.data, sizeof(size_t) * calls.size) ==
+           0);
+    call_list_free(&calls);
+  }
+  call_list_free(&expected);
+  body_store_free();
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_workers_match_one_thread)
+  DO_TEST(test_handler_order_matches_one_thread)
+
+  puts("threads_test PASS");
+}